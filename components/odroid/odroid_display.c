@@ -55,6 +55,12 @@ static short x_origin = 0;
 static short y_origin = 0;
 static int8_t screen_line_is_empty[SCREEN_HEIGHT];
 
+// Where the pixels of the next data transaction will land, when the last window
+// was opened by odroid_display_write. A rect right below it can skip the commands.
+static struct {
+    short left, right, top;
+} write_cursor = {-1, -1, -1};
+
 typedef struct {
     int8_t start  : 1; // Indicates this line or column is safe to start an update on
     int8_t stop   : 1; // Indicates this line or column is safe to end an update on
@@ -309,6 +315,8 @@ static void send_reset_drawing(short left, short top, short width, short height)
     short right = left + width - 1;
     short bottom = SCREEN_HEIGHT - 1;
 
+    write_cursor.top = -1;
+
     // odroid_display_drain_spi();
 
     if (height == 1)
@@ -947,11 +955,24 @@ void odroid_display_drain_spi()
     }
 }
 
+// Overlays are drawn by the main task, don't let them interleave with a frame
+static void wait_video_task()
+{
+    while (videoTaskQueue && uxQueueMessagesWaiting(videoTaskQueue) > 0)
+    {
+        vTaskDelay(1);
+    }
+}
+
 void odroid_display_write(short left, short top, short width, short height, uint16_t* buffer)
 {
-    odroid_display_drain_spi();
+    wait_video_task();
 
-    send_reset_drawing(left, top, width, height);
+    // Rects stacked in the same columns (text lines, fills) continue the same window
+    if (left != write_cursor.left || left + width - 1 != write_cursor.right || top != write_cursor.top)
+    {
+        send_reset_drawing(left, top, width, height);
+    }
 
     short lines_per_buffer = SPI_TRANSACTION_BUFFER_LENGTH / width;
 
@@ -962,16 +983,23 @@ void odroid_display_write(short left, short top, short width, short height, uint
         if (y + lines_per_buffer > height)
             lines_per_buffer = height - y;
 
+        uint16_t *src = buffer + y * width;
         for (short i = 0; i < width * lines_per_buffer; ++i)
         {
-            uint16_t pixel = buffer[y * width + i];
+            uint16_t pixel = src[i];
             line_buffer[i] = pixel << 8 | pixel >> 8;
         }
 
         send_continue_line(line_buffer, width, lines_per_buffer);
     }
 
-    odroid_display_drain_spi();
+    // A single line window may be wider than the rect, see send_reset_drawing
+    if (height > 1 || write_cursor.top == top)
+    {
+        write_cursor.left = left;
+        write_cursor.right = left + width - 1;
+        write_cursor.top = top + height;
+    }
 }
 
 void odroid_display_clear(uint16_t color)
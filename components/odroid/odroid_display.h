@@ -73,7 +73,9 @@ short odroid_display_queue_update(odroid_video_frame *frame, odroid_video_frame
 
 void odroid_display_init();
 void odroid_display_deinit();
+// Waits until everything queued has reached the display
 void odroid_display_drain_spi();
+// Copies the rect to the SPI pool and returns, the buffer can be reused right away
 void odroid_display_write(short left, short top, short width, short height, uint16_t* bufferLE);
 void odroid_display_clear(uint16_t colorLE);
 void odroid_display_show_hourglass();
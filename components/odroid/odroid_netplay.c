@@ -9,10 +9,13 @@
 #include <netdb.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/param.h>
 
 #include "odroid_system.h"
+#include "odroid_netplay_sync.h"
+#include "odroid_netplay_transport.h"
 
-#define NETPLAY_VERSION 0x01
+#define NETPLAY_VERSION 0x03
 #define MAX_PLAYERS 8
 
 #define BROADCAST (inet_addr(WIFI_BROADCAST_ADDR))
@@ -23,9 +26,12 @@
 #define WIFI_BROADCAST_ADDR "192.168.4.255"
 #define WIFI_NETPLAY_PORT 1234
 
-// Test to skip the network task and semaphores
+// Test to skip the network task and semaphores, the sync reads the transport itself
 #define NETPLAY_SYNCHRONOUS_TEST
 
+// Wraps the transport to add delay (ms), jitter (ms) and loss (%) to incoming packets
+// #define NETPLAY_IMPAIRMENT 20, 10, 5
+
 static netplay_status_t netplay_status = NETPLAY_STATUS_NOT_INIT;
 static netplay_mode_t netplay_mode = NETPLAY_MODE_NONE;
 static netplay_callback_t netplay_callback = NULL;
@@ -39,9 +45,8 @@ static netplay_player_t *remote_player; // This only works in 2 player mode
 static tcpip_adapter_ip_info_t local_if;
 static wifi_config_t wifi_config;
 
-static int server_sock, client_sock; // TCP
-static int rx_sock, tx_sock; // UDP
-static struct sockaddr_in rx_addr, tx_addr;
+static const netplay_transport_t *transport;
+static bool transport_open = false;
 
 
 static void dummy_netplay_callback(netplay_event_t event, void *arg)
@@ -52,13 +57,9 @@ static void dummy_netplay_callback(netplay_event_t event, void *arg)
 
 static void network_cleanup()
 {
-    if (rx_sock) close(rx_sock);
-    if (tx_sock) close(tx_sock);
-    if (server_sock) close(server_sock);
-    if (client_sock) close(client_sock);
+    if (transport_open) (*transport->close)();
 
-    rx_sock = tx_sock = NULL;
-    server_sock = client_sock = NULL;
+    transport_open = false;
     memset(&local_if, 0, sizeof(local_if));
 }
 
@@ -77,74 +78,58 @@ static void network_setup(tcpip_adapter_if_t tcpip_if)
 
     printf("netplay: Local player ID: %d\n", local_player->id);
 
-    rx_addr.sin_family = AF_INET;
-    rx_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    rx_addr.sin_port = htons(WIFI_NETPLAY_PORT);
-
-    tx_addr.sin_family = AF_INET;
-    tx_addr.sin_addr.s_addr = inet_addr(WIFI_BROADCAST_ADDR);
-    tx_addr.sin_port = htons(WIFI_NETPLAY_PORT);
-
-    rx_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    tx_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    assert(rx_sock > 0 && tx_sock > 0);
-
-    // server_sock = socket(AF_INET, SOCK_STREAM, 0);
-    // client_sock = socket(AF_INET, SOCK_STREAM, 0);
-    // assert(client_sock > 0 && server_sock > 0);
+    if (!transport)
+    {
+        transport = netplay_transport_udp(WIFI_NETPLAY_PORT, WIFI_NETPLAY_PORT);
+    #ifdef NETPLAY_IMPAIRMENT
+        transport = netplay_transport_impaired(transport, NETPLAY_IMPAIRMENT);
+    #endif
+    }
 
-    if (bind(rx_sock, (struct sockaddr *)&rx_addr, sizeof rx_addr) < 0)
+    if (!(*transport->open)())
     {
-        printf("netplay: bind() failed\n");
+        printf("netplay: Transport open failed\n");
         abort();
     }
 
-    // if (bind(server_sock, (struct sockaddr *)&rx_addr, sizeof rx_addr) < 0)
-    // {
-    //     printf("netplay: bind() failed\n");
-    //     abort();
-    // }
-
-    // if (listen(server_sock, 2) < 0)
-    // {
-    //     printf("netplay: listen() failed\n");
-    //     abort();
-    // }
+    transport_open = true;
 }
 
 
-static void set_status(netplay_status_t status)
+#ifndef NETPLAY_SYNCHRONOUS_TEST
+// The task hands the packets to the sync as they come
+static bool wait_packets(int timeout)
 {
-    bool changed = status != netplay_status;
-
-    netplay_status = status;
-
-    if (changed)
-    {
-        (*netplay_callback)(NETPLAY_EVENT_STATUS_CHANGED, &netplay_status);
-    }
+    return xSemaphoreTake(netplay_sync, pdMS_TO_TICKS(timeout)) == pdPASS;
 }
+#endif
 
 
-static inline bool receive_packet(netplay_packet_t *packet, int timeout)
+static void set_status(netplay_status_t status)
 {
-    fd_set read_fd_set;
-
-    FD_ZERO(&read_fd_set);
-    FD_SET(rx_sock, &read_fd_set);
+    bool changed = status != netplay_status;
 
-    int sel = select(FD_SETSIZE, &read_fd_set, NULL, NULL, NULL);
+    netplay_status = status;
 
-    if (sel > 0)
+    if (changed && status == NETPLAY_STATUS_CONNECTED)
     {
-        return recv(rx_sock, &packet, sizeof packet, 0) >= 0;
+        netplay_peer_t peer = {
+            .transport = transport,
+            .local_id = local_player->id,
+            .remote_id = remote_player->id,
+            .remote_addr = remote_player->ip_addr,
+            .host = netplay_mode == NETPLAY_MODE_HOST,
+        #ifndef NETPLAY_SYNCHRONOUS_TEST
+            .wait = &wait_packets,
+        #endif
+        };
+        netplay_sync_start(&peer);
     }
-    else if (sel < 0)
+
+    if (changed)
     {
-        printf("netplay: [Error] select() failed\n");
+        (*netplay_callback)(NETPLAY_EVENT_STATUS_CHANGED, &netplay_status);
     }
-
-    return false;
 }
 
 
@@ -160,19 +145,14 @@ static inline void send_packet(uint32_t dest, uint8_t cmd, uint8_t arg, void *da
 
     if (dest < MAX_PLAYERS)
     {
-        tx_addr.sin_addr.s_addr = players[dest].ip_addr;
-    }
-    else
-    {
-        tx_addr.sin_addr.s_addr = dest;
+        dest = players[dest].ip_addr;
     }
 
-    if (sendto(tx_sock, &packet, len, 0, (struct sockaddr*)&tx_addr, sizeof tx_addr) <= 0)
+    if (!(*transport->send)(dest, &packet, len))
     {
-        printf("netplay: [Error] sendto() failed\n");
+        printf("netplay: [Error] send failed\n");
         // stop network
     }
-    // return send(client_sock, &packet, len, 0) >= 0;
 }
 
 
@@ -232,19 +212,18 @@ static void netplay_task()
         memset(&packet, 0, sizeof(netplay_packet_t));
 
     #ifdef NETPLAY_SYNCHRONOUS_TEST
-        if (!(rx_sock || client_sock) || netplay_status != NETPLAY_STATUS_HANDSHAKE)
+        if (!transport_open || netplay_status != NETPLAY_STATUS_HANDSHAKE)
     #else
-        if (!(rx_sock || client_sock) || netplay_status < NETPLAY_STATUS_HANDSHAKE)
+        if (!transport_open || netplay_status < NETPLAY_STATUS_HANDSHAKE)
     #endif
         {
             vTaskDelay(pdMS_TO_TICKS(100));
             continue;
         }
 
-        // if ((len = recv(client_sock, &packet, sizeof packet, 0)) <= 0)
-        if ((len = recvfrom(rx_sock, &packet, sizeof packet, 0, NULL, 0)) <= 0)
+        if ((len = (*transport->receive)(&packet, sizeof packet, -1)) <= 0)
         {
-            printf("netplay: [Error] Socket disconnected! (recv() failed)\n");
+            printf("netplay: [Error] Socket disconnected! (receive failed)\n");
             vTaskDelay(pdMS_TO_TICKS(100));
             continue;
         }
@@ -316,20 +295,9 @@ static void netplay_task()
                 set_status(NETPLAY_STATUS_CONNECTED);
                 break;
 
-            case NETPLAY_PACKET_SYNC_REQ: // HOST -> GUEST
-                memcpy(&packet_from->sync_data, packet.data, packet.data_len);
-                xSemaphoreGive(netplay_sync);
-                break;
-
-            case NETPLAY_PACKET_SYNC_ACK: // GUEST -> HOST
-                memcpy(&packet_from->sync_data, packet.data, packet.data_len);
-
-                // if received all players ACK then:
-                send_packet(remote_player->id, NETPLAY_PACKET_SYNC_DONE, packet.arg, 0, 0);
-                xSemaphoreGive(netplay_sync);
-                break;
-
-            case NETPLAY_PACKET_SYNC_DONE: // HOST -> GUEST
+            case NETPLAY_PACKET_INPUT: // HOST <-> GUEST
+            case NETPLAY_PACKET_RAW_DATA: // HOST <-> GUEST
+                netplay_sync_receive(&packet);
                 xSemaphoreGive(netplay_sync);
                 break;
 
@@ -351,7 +319,7 @@ static void netplay_init()
         netplay_status = NETPLAY_STATUS_STOPPED;
         netplay_callback = netplay_callback ?: dummy_netplay_callback;
         netplay_mode = NETPLAY_MODE_NONE;
-        netplay_sync = xSemaphoreCreateMutex();
+        netplay_sync = xSemaphoreCreateBinary();
 
         tcpip_adapter_init();
 
@@ -526,72 +494,30 @@ bool odroid_netplay_stop()
 }
 
 
+// Records data_in as the local input for a later frame, then waits for the
+// remote input of the current frame. On return data_in and data_out hold the
+// local and remote inputs to run this frame with.
 void odroid_netplay_sync(void *data_in, void *data_out, uint8_t data_len)
 {
 #ifdef ENABLE_NETPLAY
-    static uint sync_count = 0, sync_time = 0, start_time = 0;
-    static netplay_packet_t packet;
-
     if (netplay_status != NETPLAY_STATUS_CONNECTED)
     {
         return;
     }
 
-    start_time = get_elapsed_time();
-
-    memcpy(&local_player->sync_data, data_in, data_len);
-
-    if (netplay_mode == NETPLAY_MODE_HOST)
+    if (!netplay_sync_frame(data_in, data_out, data_len))
     {
-        send_packet(remote_player->id, NETPLAY_PACKET_SYNC_REQ, 0, data_in, data_len);
-    }
-
-#ifdef NETPLAY_SYNCHRONOUS_TEST
-    if (netplay_mode == NETPLAY_MODE_HOST)
-    {
-        do {
-            recv(rx_sock, &packet, sizeof packet, 0); // ACK
-        } while (packet.cmd != NETPLAY_PACKET_SYNC_ACK);
-        // send_packet(remote_player->id, NETPLAY_PACKET_SYNC_DONE, packet.arg, 0, 0);
-    }
-    else
-    {
-        do {
-            recv(rx_sock, &packet, sizeof packet, 0); // REQ
-        } while (packet.cmd != NETPLAY_PACKET_SYNC_REQ);
-        send_packet(remote_player->id, NETPLAY_PACKET_SYNC_ACK, 0, data_in, data_len);
-        // recv(rx_sock, &packet, sizeof packet, 0); // DONE
-    }
-
-    memcpy(&remote_player->sync_data, packet.data, packet.data_len);
-    memcpy(data_out, remote_player->sync_data, data_len);
-#else
-    // wait to receive/send NETPLAY_PACKET_SYNC_DONE
-    if (xSemaphoreTake(netplay_sync, 10000 / portTICK_PERIOD_MS) != pdPASS)
-    {
-        printf("netplay: [Error] Lost sync...\n");
         odroid_netplay_stop();
-        return;
-    }
-
-    memcpy(data_out, remote_player->sync_data, data_len);
-
-    if (netplay_mode == NETPLAY_MODE_GUEST)
-    {
-        send_packet(remote_player->id, NETPLAY_PACKET_SYNC_ACK, 0,
-                    local_player->sync_data, sizeof(local_player->sync_data));
-        xSemaphoreTake(netplay_sync, 1000 / portTICK_PERIOD_MS);
     }
 #endif
+}
 
-    sync_time += get_elapsed_time_since(start_time);
 
-    if (++sync_count == 60)
-    {
-        printf("netplay: Sync delay=%.4fms\n", (float)sync_time / sync_count / 1000);
-        sync_count = sync_time = 0;
-    }
-#endif
+// Replaces the default UDP transport, must be called before starting netplay
+void odroid_netplay_set_transport(const netplay_transport_t *new_transport)
+{
+    assert(!transport_open);
+    transport = new_transport;
 }
 
 
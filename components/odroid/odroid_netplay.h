@@ -1,5 +1,7 @@
 #pragma once
 
+#include "odroid_netplay_transport.h"
+
 typedef enum {
     NETPLAY_MODE_NONE,
     NETPLAY_MODE_HOST,
@@ -28,7 +30,7 @@ typedef enum {
     NETPLAY_PACKET_PING,       //
     NETPLAY_PACKET_PONG,       //
     NETPLAY_PACKET_READY,      // Sent by the host once all players are ready
-    // Synchronization packets
+    // Synchronization packets (lockstep protocol v1, unused since inputs are delayed)
     NETPLAY_PACKET_SYNC_REQ,   // Sent by the host to all players after reading input
     NETPLAY_PACKET_SYNC_ACK,   // Sent by the guests after reading input and receiving SYNC_REQ
     NETPLAY_PACKET_SYNC_DONE,  // Sent by the host when all guests have ACK, starts frame emulation
@@ -37,7 +39,7 @@ typedef enum {
     NETPLAY_PACKET_GAME_START,  //
     NETPLAY_PACKET_GAME_PAUSE,  //
     NETPLAY_PACKET_GAME_RESET,  //
-    NETPLAY_PACKET_INPUT,       // Send gamepad data
+    NETPLAY_PACKET_INPUT,       // Send gamepad data, see netplay_input_t
     NETPLAY_PACKET_SERIAL,      // Send serial data
     NETPLAY_PACKET_RAW_DATA,    // Send raw data for the emulator to handle (serial, memory copy, etc)
 } netplay_packet_type_t;
@@ -50,6 +52,53 @@ typedef struct __attribute__ ((packed)) {
     uint8_t data[128];
 } netplay_packet_t;
 
+// Payload of NETPLAY_PACKET_INPUT (arg is a sequence number). Carries the
+// sender's inputs for frames [frame, frame + count) so that every packet
+// repeats whatever the peer hasn't acknowledged yet.
+typedef struct __attribute__ ((packed)) {
+    uint32_t frame;    // Frame of the first input
+    uint32_t received; // Number of the peer's frames the sender has, ie ack
+    uint32_t hash_frame; // Last frame the sender hashed its state at
+    uint32_t hash;
+    uint8_t  transfer; // Last state transfer, inputs from before it are dropped
+    uint8_t  count;
+    uint8_t  size;     // Size of each input
+    uint8_t  inputs[];
+} netplay_input_t;
+
+#define NETPLAY_STALL_BUCKETS 8
+
+typedef enum {
+    NETPLAY_TRANSFER_DATA,
+    NETPLAY_TRANSFER_ACK,
+} netplay_transfer_cmd_t;
+
+// Payload of NETPLAY_PACKET_RAW_DATA (arg is a netplay_transfer_cmd_t). Every
+// chunk repeats the header so that any of them can start the transfer.
+typedef struct __attribute__ ((packed)) {
+    uint8_t  id;        // A new id starts a new transfer
+    uint32_t offset;    // DATA: offset of the chunk, ACK: bytes received in order
+    uint32_t size;      // Size of the data sent
+    uint32_t real_size; // Size once inflated, same as size if it wasn't deflated
+    uint32_t checksum;  // crc32 of the inflated data
+    uint8_t  data[];
+} netplay_transfer_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t stalls;        // Frames that had to wait for the remote input
+    uint32_t stall_time;    // us
+    uint32_t max_stall;     // us
+    uint32_t packets_sent;
+    uint32_t packets_received;
+    uint32_t packets_lost;  // Gaps in the sequence numbers
+    uint32_t resent;        // Packets sent again while stalled
+    uint32_t rollbacks;
+    uint32_t resimulated;   // Frames run again after a misprediction
+    uint32_t desyncs;       // State hashes that didn't match the peer's
+    uint32_t stall_hist[NETPLAY_STALL_BUCKETS]; // Stalls under 1, 2, 4, ... 64ms and above
+} netplay_stats_t;
+
 typedef struct __attribute__ ((packed)) {
     uint8_t  version;
     uint8_t  id;
@@ -61,12 +110,18 @@ typedef struct __attribute__ ((packed)) {
 } netplay_player_t;
 
 typedef void (*netplay_callback_t)(netplay_event_t event, void *arg);
+// Runs one frame with the given inputs and no video or audio output
+typedef void (*netplay_frame_handler_t)(void *local, void *remote);
 
 void odroid_netplay_pre_init(netplay_callback_t callback);
 bool odroid_netplay_quick_start();
 bool odroid_netplay_start(netplay_mode_t mode);
 bool odroid_netplay_stop();
 void odroid_netplay_sync(void *data_in, void *data_out, uint8_t data_len);
+void odroid_netplay_set_input_delay(uint8_t frames);
+void odroid_netplay_set_rollback(netplay_frame_handler_t run_frame);
+void odroid_netplay_set_transport(const netplay_transport_t *transport);
+netplay_stats_t odroid_netplay_get_stats(bool reset);
 
 netplay_mode_t odroid_netplay_mode();
 netplay_status_t odroid_netplay_status();
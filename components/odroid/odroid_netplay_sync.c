@@ -0,0 +1,734 @@
+#include "odroid_system.h"
+#include "odroid_netplay_sync.h"
+#include "rom/crc.h"
+#include "../miniz/miniz.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+
+// Local inputs are applied this many frames after being read, which gives them
+// that much time to reach the peer before it needs them
+#define NETPLAY_DEFAULT_INPUT_DELAY 2
+#define NETPLAY_MAX_INPUT_DELAY 8
+#define NETPLAY_INPUT_RING 32 // Must be a power of two, well above twice the delay
+#define NETPLAY_RESEND_INTERVAL 5 // ms
+#define NETPLAY_SYNC_TIMEOUT 10000 // ms
+
+// With rollback the remote input is predicted instead of waited for, as long
+// as the oldest unconfirmed frame is within this many frames
+#define NETPLAY_ROLLBACK_FRAMES 8
+
+// Both peers hash their state at frames that are a multiple of this to detect desyncs
+#define NETPLAY_HASH_INTERVAL 60
+// Chunks of a state transfer sent before waiting for an ack
+#define NETPLAY_TRANSFER_WINDOW 16
+#define NETPLAY_TRANSFER_CHUNK (sizeof(((netplay_packet_t*)0)->data) - sizeof(netplay_transfer_t))
+#define NETPLAY_DEFLATE_FLAGS (1 | TDEFL_GREEDY_PARSING_FLAG)
+
+typedef struct {
+    uint32_t frame;
+    uint8_t data[16];
+} netplay_frame_input_t;
+
+static netplay_peer_t peer;
+
+static uint8_t input_delay = NETPLAY_DEFAULT_INPUT_DELAY;
+
+static struct {
+    uint32_t frame;           // Next frame to run
+    uint32_t local_count;     // Local inputs recorded, frame + delay once running
+    uint32_t remote_count;    // Contiguous remote inputs received
+    uint32_t peer_received;   // Local inputs the peer has acknowledged
+    uint8_t  delay;
+    uint8_t  data_len;
+    uint8_t  tx_seq, rx_seq;
+    uint32_t rx_count;
+    uint8_t  transfer;        // State transfer the inputs started from
+    uint32_t hash_frame, hash;
+    uint32_t remote_hash_frame, remote_hash;
+    uint32_t checked_frame;   // Last frame whose hashes were compared
+    uint32_t hash_matches;
+    netplay_frame_input_t local[NETPLAY_INPUT_RING];
+    netplay_frame_input_t remote[NETPLAY_INPUT_RING];
+    netplay_stats_t stats;
+} input_sync;
+
+// Frames that ran on a predicted remote input keep a snapshot taken right
+// before them, and the prediction, until the real input confirms it or not
+static struct {
+    netplay_frame_handler_t run_frame;
+    uint32_t confirmed;       // Frames before this one ran on real inputs
+    size_t   state_size;
+    uint8_t *states;          // NETPLAY_ROLLBACK_FRAMES snapshots
+    netplay_frame_input_t predicted[NETPLAY_INPUT_RING];
+} rollback;
+
+// The host sends its state to the guest before the first frame, so that they
+// don't have to start from identical conditions, and again after a desync
+static struct {
+    bool     pending;         // Must happen before the next frame
+    uint8_t  id;
+    uint32_t offset;          // Bytes acknowledged (host) or received (guest)
+    uint32_t size, real_size, checksum;
+    size_t   state_size;
+    uint8_t *state;           // Also used to hash the state
+    uint8_t *data;            // What is sent, deflated if that made it smaller
+} transfer;
+
+
+static inline bool receive_packet(netplay_packet_t *packet, int timeout)
+{
+    int len = (*peer.transport->receive)(packet, sizeof(netplay_packet_t), timeout);
+
+    return len > 0 && len == sizeof(netplay_packet_t) - sizeof(packet->data) + packet->data_len;
+}
+
+
+static inline void send_packet(uint8_t cmd, uint8_t arg, void *data, uint8_t data_len)
+{
+    netplay_packet_t packet = {peer.local_id, cmd, arg, data_len};
+    size_t len = sizeof(packet) - sizeof(packet.data) + data_len;
+
+    if (data_len > 0)
+    {
+        memcpy(&packet.data, data, data_len);
+    }
+
+    if (!(*peer.transport->send)(peer.remote_addr, &packet, len))
+    {
+        printf("netplay: [Error] send failed\n");
+    }
+}
+
+
+static void reset_inputs()
+{
+    netplay_stats_t stats = input_sync.stats;
+
+    memset(&input_sync, 0, sizeof(input_sync));
+    input_sync.stats = stats;
+    input_sync.hash_frame = input_sync.remote_hash_frame = input_sync.checked_frame = UINT32_MAX;
+
+    for (int i = 0; i < NETPLAY_INPUT_RING; i++)
+    {
+        input_sync.local[i].frame = input_sync.remote[i].frame = UINT32_MAX;
+    }
+
+    // Nothing was read for the first frames, they run with neutral inputs
+    input_sync.delay = input_delay;
+    for (int i = 0; i < input_sync.delay; i++)
+    {
+        input_sync.local[i].frame = i;
+    }
+    input_sync.local_count = input_sync.delay;
+
+    rollback.confirmed = 0;
+    for (int i = 0; i < NETPLAY_INPUT_RING; i++)
+    {
+        rollback.predicted[i].frame = UINT32_MAX;
+    }
+}
+
+
+// Returns the remote input of frame, or a prediction if it hasn't arrived
+static bool remote_input(uint32_t frame, void *data_out)
+{
+    netplay_frame_input_t *remote = &input_sync.remote[frame % NETPLAY_INPUT_RING];
+
+    if (remote->frame == frame)
+    {
+        memcpy(data_out, remote->data, input_sync.data_len);
+        return true;
+    }
+
+    // Players tend to hold buttons, so the last known input is the best guess
+    remote = &input_sync.remote[(input_sync.remote_count - 1) % NETPLAY_INPUT_RING];
+    if (input_sync.remote_count > 0 && remote->frame == input_sync.remote_count - 1)
+        memcpy(data_out, remote->data, input_sync.data_len);
+    else
+        memset(data_out, 0, input_sync.data_len);
+
+    return false;
+}
+
+
+// Snapshots the emulator before a frame that runs on a prediction
+static void rollback_prepare(uint32_t frame, void *remote_data, bool confirmed)
+{
+    netplay_frame_input_t *predicted = &rollback.predicted[frame % NETPLAY_INPUT_RING];
+
+    if (confirmed)
+    {
+        predicted->frame = UINT32_MAX;
+        return;
+    }
+
+    void *state = rollback.states + (frame % NETPLAY_ROLLBACK_FRAMES) * rollback.state_size;
+    odroid_system_emu_save_state_mem(state, rollback.state_size);
+    memcpy(predicted->data, remote_data, input_sync.data_len);
+    predicted->frame = frame;
+}
+
+
+// Checks the predictions against the inputs received since and, at the first
+// one that was wrong, restores its snapshot and runs the frames up to the
+// current one again
+static void rollback_check(uint32_t frame)
+{
+    uint8_t remote_data[sizeof(input_sync.remote[0].data)];
+
+    while (rollback.confirmed < frame && rollback.confirmed < input_sync.remote_count)
+    {
+        uint32_t first = rollback.confirmed;
+        netplay_frame_input_t *predicted = &rollback.predicted[first % NETPLAY_INPUT_RING];
+        netplay_frame_input_t *remote = &input_sync.remote[first % NETPLAY_INPUT_RING];
+
+        rollback.confirmed++;
+
+        if (predicted->frame != first || memcmp(predicted->data, remote->data, input_sync.data_len) == 0)
+            continue;
+
+        void *state = rollback.states + (first % NETPLAY_ROLLBACK_FRAMES) * rollback.state_size;
+        odroid_system_emu_load_state_mem(state, rollback.state_size);
+
+        for (uint32_t f = first; f < frame; f++)
+        {
+            bool confirmed = remote_input(f, remote_data);
+            rollback_prepare(f, remote_data, confirmed);
+            (*rollback.run_frame)(input_sync.local[f % NETPLAY_INPUT_RING].data, remote_data);
+        }
+
+        input_sync.stats.rollbacks++;
+        input_sync.stats.resimulated += frame - first;
+    }
+}
+
+
+static void send_inputs()
+{
+    uint8_t buffer[sizeof(((netplay_packet_t*)0)->data)];
+    netplay_input_t *input = (netplay_input_t *)buffer;
+    int max_count = (sizeof(buffer) - sizeof(netplay_input_t)) / input_sync.data_len;
+
+    // Repeat everything the peer hasn't acknowledged, oldest first
+    input->frame = input_sync.peer_received;
+    input->received = input_sync.remote_count;
+    input->hash_frame = input_sync.hash_frame;
+    input->hash = input_sync.hash;
+    input->transfer = input_sync.transfer;
+    input->count = MIN(input_sync.local_count - input_sync.peer_received, max_count);
+    input->size = input_sync.data_len;
+
+    for (int i = 0; i < input->count; i++)
+    {
+        netplay_frame_input_t *local = &input_sync.local[(input->frame + i) % NETPLAY_INPUT_RING];
+        memcpy(input->inputs + i * input->size, local->data, input->size);
+    }
+
+    send_packet(NETPLAY_PACKET_INPUT, input_sync.tx_seq++, buffer,
+                sizeof(netplay_input_t) + input->count * input->size);
+    input_sync.stats.packets_sent++;
+}
+
+
+static void receive_inputs(netplay_packet_t *packet)
+{
+    netplay_input_t *input = (netplay_input_t *)packet->data;
+    uint8_t seq_diff = packet->arg - input_sync.rx_seq;
+
+    if (packet->data_len < sizeof(netplay_input_t)
+        || packet->data_len != sizeof(netplay_input_t) + input->count * input->size
+        || input->size > sizeof(input_sync.remote[0].data))
+    {
+        printf("netplay: [Error] Invalid input packet.\n");
+        return;
+    }
+
+    // Sent before the last state transfer, the frames don't match ours
+    if (input->transfer != input_sync.transfer)
+    {
+        return;
+    }
+
+    // Late packets were already counted as lost, they're redundant anyway
+    if (input_sync.rx_count > 0 && seq_diff > 1 && seq_diff < 128)
+    {
+        input_sync.stats.packets_lost += seq_diff - 1;
+    }
+    if (input_sync.rx_count == 0 || (seq_diff > 0 && seq_diff < 128))
+    {
+        input_sync.rx_seq = packet->arg;
+    }
+    input_sync.stats.packets_received++;
+    input_sync.rx_count++;
+
+    if ((int32_t)(input->received - input_sync.peer_received) > 0 && input->received <= input_sync.local_count)
+    {
+        input_sync.peer_received = input->received;
+    }
+
+    if ((int32_t)(input->hash_frame - input_sync.remote_hash_frame) > 0)
+    {
+        input_sync.remote_hash_frame = input->hash_frame;
+        input_sync.remote_hash = input->hash;
+    }
+
+    for (int i = 0; i < input->count; i++)
+    {
+        uint32_t frame = input->frame + i;
+
+        // Already have it, or too far ahead to fit the ring
+        if ((int32_t)(frame - input_sync.remote_count) < 0 || frame - input_sync.remote_count >= NETPLAY_INPUT_RING)
+            continue;
+
+        netplay_frame_input_t *remote = &input_sync.remote[frame % NETPLAY_INPUT_RING];
+        memcpy(remote->data, input->inputs + i * input->size, input->size);
+        remote->frame = frame;
+    }
+
+    while (input_sync.remote[input_sync.remote_count % NETPLAY_INPUT_RING].frame == input_sync.remote_count)
+    {
+        input_sync.remote_count++;
+    }
+}
+
+
+static void send_transfer_packet(uint8_t cmd, uint32_t offset, size_t len)
+{
+    uint8_t buffer[sizeof(((netplay_packet_t*)0)->data)];
+    netplay_transfer_t *chunk = (netplay_transfer_t *)buffer;
+
+    chunk->id = transfer.id;
+    chunk->offset = offset;
+    chunk->size = transfer.size;
+    chunk->real_size = transfer.real_size;
+    chunk->checksum = transfer.checksum;
+    memcpy(chunk->data, transfer.data + offset, len);
+
+    send_packet(NETPLAY_PACKET_RAW_DATA, cmd, buffer, sizeof(netplay_transfer_t) + len);
+}
+
+
+static void receive_transfer(netplay_packet_t *packet)
+{
+    netplay_transfer_t *chunk = (netplay_transfer_t *)packet->data;
+    size_t len = packet->data_len - sizeof(netplay_transfer_t);
+
+    if (packet->data_len < sizeof(netplay_transfer_t))
+    {
+        printf("netplay: [Error] Invalid transfer packet.\n");
+        return;
+    }
+
+    if (packet->arg == NETPLAY_TRANSFER_ACK)
+    {
+        if (chunk->id == transfer.id && chunk->offset > transfer.offset)
+            transfer.offset = MIN(chunk->offset, transfer.size);
+        return;
+    }
+
+    // A new transfer interrupts whatever the emulator was waiting for. Until
+    // the buffers exist nothing is acknowledged and the host will resend.
+    if ((int8_t)(chunk->id - transfer.id) > 0)
+    {
+        if (!transfer.data || chunk->size > transfer.state_size || chunk->real_size > transfer.state_size)
+            return;
+
+        transfer.id = chunk->id;
+        transfer.offset = 0;
+        transfer.size = chunk->size;
+        transfer.real_size = chunk->real_size;
+        transfer.checksum = chunk->checksum;
+        transfer.pending = true;
+    }
+
+    if (chunk->id != transfer.id)
+    {
+        return;
+    }
+
+    // Only in order, anything else is resent from the acknowledged offset anyway
+    if (chunk->offset == transfer.offset && len <= transfer.size - transfer.offset)
+    {
+        memcpy(transfer.data + transfer.offset, chunk->data, len);
+        transfer.offset += len;
+    }
+
+    send_transfer_packet(NETPLAY_TRANSFER_ACK, transfer.offset, 0);
+}
+
+
+// Waits up to timeout ms for the next packet from the remote player
+static bool poll_packets(int timeout)
+{
+    netplay_packet_t packet;
+
+    if (peer.wait)
+        return (*peer.wait)(timeout);
+
+    if (!receive_packet(&packet, timeout))
+        return false;
+
+    if (packet.player_id == peer.remote_id)
+        netplay_sync_receive(&packet);
+
+    return true;
+}
+
+
+// Host: snapshots the emulator and sends it, go-back-N style
+static bool send_state()
+{
+    size_t size = odroid_system_emu_save_state_mem(transfer.state, transfer.state_size);
+    size_t in_size = size, out_size = transfer.state_size;
+
+    tdefl_compressor *deflator = heap_caps_malloc(sizeof(tdefl_compressor), MEM_SLOW);
+    if (!deflator)
+    {
+        printf("netplay: [Error] Not enough memory to send the state\n");
+        return false;
+    }
+
+    tdefl_init(deflator, NULL, NULL, NETPLAY_DEFLATE_FLAGS);
+    if (tdefl_compress(deflator, transfer.state, &in_size, transfer.data, &out_size, TDEFL_FINISH) != TDEFL_STATUS_DONE
+        || out_size >= size)
+    {
+        memcpy(transfer.data, transfer.state, size);
+        out_size = size;
+    }
+    free(deflator);
+
+    // Zero is what the guest starts with
+    if (++transfer.id == 0)
+        transfer.id = 1;
+    transfer.offset = 0;
+    transfer.size = out_size;
+    transfer.real_size = size;
+    transfer.checksum = crc32_le(0, transfer.state, size);
+
+    reset_inputs();
+    input_sync.transfer = transfer.id;
+
+    uint last_progress = get_elapsed_time();
+    uint32_t acked = 0, sent = 0;
+
+    while (transfer.offset < transfer.size)
+    {
+        if (transfer.offset != acked)
+        {
+            acked = transfer.offset;
+            last_progress = get_elapsed_time();
+        }
+        else if (get_elapsed_time_since(last_progress) > NETPLAY_SYNC_TIMEOUT * 1000)
+        {
+            return false;
+        }
+
+        sent = MAX(sent, acked);
+
+        while (sent < transfer.size && sent < acked + NETPLAY_TRANSFER_WINDOW * NETPLAY_TRANSFER_CHUNK)
+        {
+            size_t len = MIN(NETPLAY_TRANSFER_CHUNK, transfer.size - sent);
+            send_transfer_packet(NETPLAY_TRANSFER_DATA, sent, len);
+            sent += len;
+        }
+
+        // Nothing came back, resend the whole window
+        if (!poll_packets(NETPLAY_RESEND_INTERVAL))
+        {
+            sent = transfer.offset;
+        }
+    }
+
+    return true;
+}
+
+
+// Guest: waits for the host's state and loads it
+static bool receive_state()
+{
+    uint last_progress = get_elapsed_time();
+    uint32_t received = 0;
+
+    while (transfer.id == input_sync.transfer || transfer.offset < transfer.size)
+    {
+        if (transfer.offset != received)
+        {
+            received = transfer.offset;
+            last_progress = get_elapsed_time();
+        }
+        else if (get_elapsed_time_since(last_progress) > NETPLAY_SYNC_TIMEOUT * 1000)
+        {
+            return false;
+        }
+
+        poll_packets(NETPLAY_RESEND_INTERVAL);
+    }
+
+    size_t size = transfer.real_size;
+
+    if (transfer.size < transfer.real_size)
+    {
+        tinfl_decompressor *inflator = heap_caps_malloc(sizeof(tinfl_decompressor), MEM_SLOW);
+        size_t in_size = transfer.size;
+
+        if (!inflator)
+            return false;
+
+        tinfl_init(inflator);
+        if (tinfl_decompress(inflator, transfer.data, &in_size, transfer.state, transfer.state, &size,
+                TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) != TINFL_STATUS_DONE)
+            size = 0;
+        free(inflator);
+    }
+    else
+    {
+        memcpy(transfer.state, transfer.data, size);
+    }
+
+    if (size != transfer.real_size || crc32_le(0, transfer.state, size) != transfer.checksum)
+    {
+        printf("netplay: [Error] Received state is corrupted\n");
+        return false;
+    }
+
+    if (odroid_system_emu_load_state_mem(transfer.state, size) != size)
+    {
+        printf("netplay: [Error] Received state couldn't be loaded\n");
+        return false;
+    }
+
+    reset_inputs();
+    input_sync.transfer = transfer.id;
+
+    return true;
+}
+
+
+static bool sync_state()
+{
+    uint start_time = get_elapsed_time();
+
+    if (!transfer.state)
+    {
+        // Emulators without state memory handlers need identical start conditions
+        transfer.state_size = odroid_system_emu_save_state_mem(NULL, 0);
+        if (transfer.state_size == 0)
+            return true;
+
+        transfer.state = heap_caps_malloc(transfer.state_size, MEM_SLOW);
+        transfer.data = heap_caps_malloc(transfer.state_size, MEM_SLOW);
+        if (!transfer.state || !transfer.data)
+        {
+            printf("netplay: [Error] Not enough memory for the state transfer\n");
+            return false;
+        }
+    }
+
+    if (!(peer.host ? send_state() : receive_state()))
+    {
+        printf("netplay: [Error] State transfer failed\n");
+        return false;
+    }
+
+    printf("netplay: State transfer %d done, %d bytes (%d sent) in %dms\n", transfer.id,
+            transfer.real_size, transfer.size, get_elapsed_time_since(start_time) / 1000);
+
+    return true;
+}
+
+
+// Hashes the state every NETPLAY_HASH_INTERVAL frames, when all the inputs that
+// led to it are confirmed, and compares it with the peer's hash of the same frame
+static void check_state(uint32_t frame)
+{
+    if (!transfer.state)
+    {
+        return;
+    }
+
+    if (frame % NETPLAY_HASH_INTERVAL == 0 && input_sync.remote_count >= frame)
+    {
+        size_t size = odroid_system_emu_save_state_mem(transfer.state, transfer.state_size);
+        input_sync.hash = crc32_le(0, transfer.state, size);
+        input_sync.hash_frame = frame;
+    }
+
+    if (input_sync.hash_frame == input_sync.remote_hash_frame && input_sync.hash_frame != input_sync.checked_frame)
+    {
+        input_sync.checked_frame = input_sync.hash_frame;
+
+        if (input_sync.hash == input_sync.remote_hash)
+        {
+            input_sync.hash_matches++;
+        }
+        else
+        {
+            printf("netplay: [Error] Desync detected at frame %d\n", input_sync.hash_frame);
+            input_sync.stats.desyncs++;
+
+            // If not even the transferred state hashed the same, the emulator's
+            // state isn't reproducible and sending it again wouldn't help.
+            // Otherwise the guest will notice the transfer when it starts.
+            if (peer.host && input_sync.hash_matches > 0)
+                transfer.pending = true;
+        }
+    }
+}
+
+
+void netplay_sync_start(const netplay_peer_t *new_peer)
+{
+    peer = *new_peer;
+
+    reset_inputs();
+    transfer.pending = true;
+    transfer.id = 0;
+}
+
+
+void netplay_sync_receive(netplay_packet_t *packet)
+{
+    if (packet->cmd == NETPLAY_PACKET_INPUT)
+        receive_inputs(packet);
+    else if (packet->cmd == NETPLAY_PACKET_RAW_DATA)
+        receive_transfer(packet);
+}
+
+
+bool netplay_sync_frame(void *data_in, void *data_out, uint8_t data_len)
+{
+    if (transfer.pending)
+    {
+        if (!sync_state())
+        {
+            return false;
+        }
+        transfer.pending = false;
+    }
+
+    uint start_time = get_elapsed_time();
+    uint32_t frame = input_sync.frame;
+
+    assert(data_len <= sizeof(input_sync.local[0].data));
+
+    netplay_frame_input_t *local = &input_sync.local[input_sync.local_count % NETPLAY_INPUT_RING];
+    memcpy(local->data, data_in, data_len);
+    local->frame = input_sync.local_count++;
+    input_sync.data_len = data_len;
+
+    send_inputs();
+
+    // Nobody else reads the transport, take whatever arrived since the last frame
+    if (!peer.wait)
+    {
+        while (poll_packets(0));
+    }
+
+    if (rollback.run_frame && !rollback.states)
+    {
+        rollback.state_size = odroid_system_emu_save_state_mem(NULL, 0);
+        rollback.states = heap_caps_malloc(rollback.state_size * NETPLAY_ROLLBACK_FRAMES, MEM_SLOW);
+        if (!rollback.states)
+        {
+            printf("netplay: [Error] Not enough memory for rollback, using delay only\n");
+            rollback.run_frame = NULL;
+        }
+    }
+
+    // Without rollback the remote input of this frame is required, with it
+    // only one recent enough to keep the predictions within the snapshots
+    uint32_t required = rollback.run_frame ? frame - MIN(frame, NETPLAY_ROLLBACK_FRAMES - 1) : frame + 1;
+
+    // Frames whose state gets hashed can't be built on predictions
+    if (transfer.state && frame % NETPLAY_HASH_INTERVAL == 0)
+    {
+        required = MAX(required, frame);
+    }
+
+    bool stalled = input_sync.remote_count < required;
+
+    while (input_sync.remote_count < required && !transfer.pending)
+    {
+        if (get_elapsed_time_since(start_time) > NETPLAY_SYNC_TIMEOUT * 1000)
+        {
+            printf("netplay: [Error] Lost sync at frame %d...\n", frame);
+            return false;
+        }
+
+        if (poll_packets(NETPLAY_RESEND_INTERVAL))
+        {
+            continue;
+        }
+
+        // Our last packet may have been lost as well
+        send_inputs();
+        input_sync.stats.resent++;
+    }
+
+    // The host started sending its state, this frame starts over once it's loaded
+    if (transfer.pending)
+    {
+        return netplay_sync_frame(data_in, data_out, data_len);
+    }
+
+    if (rollback.run_frame)
+    {
+        rollback_check(frame);
+    }
+
+    check_state(frame);
+
+    if (rollback.run_frame)
+    {
+        rollback_prepare(frame, data_out, remote_input(frame, data_out));
+    }
+    else
+    {
+        remote_input(frame, data_out);
+    }
+
+    memcpy(data_in, input_sync.local[frame % NETPLAY_INPUT_RING].data, data_len);
+    input_sync.frame++;
+
+    uint stall_time = get_elapsed_time_since(start_time);
+
+    input_sync.stats.frames++;
+    input_sync.stats.stall_time += stall_time;
+    input_sync.stats.max_stall = MAX(input_sync.stats.max_stall, stall_time);
+    if (stalled)
+    {
+        int bucket = 0;
+        while (bucket < NETPLAY_STALL_BUCKETS - 1 && stall_time >= (1000 << bucket))
+            bucket++;
+        input_sync.stats.stall_hist[bucket]++;
+        input_sync.stats.stalls++;
+    }
+
+    return true;
+}
+
+
+void odroid_netplay_set_input_delay(uint8_t frames)
+{
+    // Takes effect on the next connection, both peers must agree on frame 0
+    input_delay = MIN(frames, NETPLAY_MAX_INPUT_DELAY);
+}
+
+
+// Enables rollback, the emulator must also have state memory handlers
+void odroid_netplay_set_rollback(netplay_frame_handler_t run_frame)
+{
+    rollback.run_frame = run_frame;
+}
+
+
+netplay_stats_t odroid_netplay_get_stats(bool reset)
+{
+    netplay_stats_t stats = input_sync.stats;
+    if (reset)
+        memset(&input_sync.stats, 0, sizeof(input_sync.stats));
+    return stats;
+}
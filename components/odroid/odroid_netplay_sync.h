@@ -0,0 +1,24 @@
+#pragma once
+
+#include "odroid_netplay.h"
+
+// Frame synchronization with the remote player: input exchange, rollback,
+// state transfers and desync detection. Besides the transport it only needs
+// the emulator's state memory handlers, the host tests build it without ESP-IDF.
+typedef struct {
+    const netplay_transport_t *transport;
+    uint8_t  local_id;
+    uint8_t  remote_id;
+    uint32_t remote_addr;
+    bool     host;
+    // Waits up to timeout ms for a packet given to netplay_sync_receive by
+    // another task. Without it the transport is read by the sync itself.
+    bool   (*wait)(int timeout);
+} netplay_peer_t;
+
+// Starts over from frame 0, the host sends its state before the first frame
+void netplay_sync_start(const netplay_peer_t *peer);
+// Same as odroid_netplay_sync, returns false once the sync is lost
+bool netplay_sync_frame(void *data_in, void *data_out, uint8_t data_len);
+// Takes NETPLAY_PACKET_INPUT and NETPLAY_PACKET_RAW_DATA, ignores the others
+void netplay_sync_receive(netplay_packet_t *packet);
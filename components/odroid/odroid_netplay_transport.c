@@ -0,0 +1,229 @@
+#include "odroid_netplay_transport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define IMPAIRED_QUEUE_SIZE 64
+
+
+static uint32_t now_ms()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+
+/* UDP */
+
+static struct {
+    int rx_sock, tx_sock;
+    uint16_t local_port, remote_port;
+} udp = {-1, -1};
+
+
+static void udp_close()
+{
+    if (udp.rx_sock >= 0) close(udp.rx_sock);
+    if (udp.tx_sock >= 0) close(udp.tx_sock);
+
+    udp.rx_sock = udp.tx_sock = -1;
+}
+
+
+static bool udp_open()
+{
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(udp.local_port);
+
+    udp.rx_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    udp.tx_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    if (udp.rx_sock < 0 || udp.tx_sock < 0
+        || bind(udp.rx_sock, (struct sockaddr *)&addr, sizeof addr) < 0)
+    {
+        printf("netplay: [Error] UDP socket setup failed on port %d\n", udp.local_port);
+        udp_close();
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool udp_send(uint32_t dest, const void *data, size_t len)
+{
+    struct sockaddr_in addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = dest;
+    addr.sin_port = htons(udp.remote_port);
+
+    return sendto(udp.tx_sock, data, len, 0, (struct sockaddr *)&addr, sizeof addr) > 0;
+}
+
+
+static int udp_receive(void *data, size_t size, int timeout)
+{
+    struct timeval tv = {timeout / 1000, (timeout % 1000) * 1000};
+    fd_set read_fd_set;
+
+    FD_ZERO(&read_fd_set);
+    FD_SET(udp.rx_sock, &read_fd_set);
+
+    int sel = select(udp.rx_sock + 1, &read_fd_set, NULL, NULL, timeout < 0 ? NULL : &tv);
+
+    if (sel > 0)
+    {
+        return recv(udp.rx_sock, data, size, 0);
+    }
+    else if (sel < 0)
+    {
+        printf("netplay: [Error] select() failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+const netplay_transport_t *netplay_transport_udp(uint16_t local_port, uint16_t remote_port)
+{
+    static const netplay_transport_t transport = {&udp_open, &udp_close, &udp_send, &udp_receive};
+
+    udp.local_port = local_port;
+    udp.remote_port = remote_port;
+
+    return &transport;
+}
+
+
+/* Impairment simulator. Incoming packets are dropped or held back for the
+   configured delay plus a random jitter (which also reorders them) before
+   being handed over. Applied on receive so that timing is exact whenever the
+   receiver is waiting. */
+
+static struct {
+    const netplay_transport_t *inner;
+    int delay, jitter, loss; // ms, ms, percent
+    int count;
+    struct {
+        uint32_t due;
+        size_t len;
+        uint8_t data[NETPLAY_TRANSPORT_MTU];
+    } queue[IMPAIRED_QUEUE_SIZE];
+} impaired;
+
+
+static bool impaired_open()
+{
+    impaired.count = 0;
+    return (*impaired.inner->open)();
+}
+
+
+static void impaired_close()
+{
+    (*impaired.inner->close)();
+}
+
+
+static bool impaired_send(uint32_t dest, const void *data, size_t len)
+{
+    return (*impaired.inner->send)(dest, data, len);
+}
+
+
+// Reads one packet from the inner transport into the queue, returns false on timeout
+static bool impaired_fetch(int timeout)
+{
+    uint8_t data[NETPLAY_TRANSPORT_MTU];
+
+    int len = (*impaired.inner->receive)(data, sizeof(data), timeout);
+    if (len <= 0)
+        return false;
+
+    if (rand() % 100 < impaired.loss || impaired.count == IMPAIRED_QUEUE_SIZE)
+        return true;
+
+    impaired.queue[impaired.count].due = now_ms() + impaired.delay + (impaired.jitter ? rand() % (impaired.jitter + 1) : 0);
+    impaired.queue[impaired.count].len = len;
+    memcpy(impaired.queue[impaired.count].data, data, len);
+    impaired.count++;
+
+    return true;
+}
+
+
+static int impaired_receive(void *data, size_t size, int timeout)
+{
+    uint32_t start = now_ms();
+
+    while (1)
+    {
+        while (impaired_fetch(0));
+
+        int next = -1;
+        for (int i = 0; i < impaired.count; i++)
+        {
+            if (next < 0 || (int32_t)(impaired.queue[i].due - impaired.queue[next].due) < 0)
+                next = i;
+        }
+
+        uint32_t now = now_ms();
+        int wait = INT_MAX;
+
+        if (next >= 0)
+        {
+            if ((int32_t)(impaired.queue[next].due - now) <= 0)
+            {
+                size_t len = impaired.queue[next].len;
+                memcpy(data, impaired.queue[next].data, MIN(len, size));
+                // Shifted rather than swapped, packets due at the same time keep their order
+                memmove(&impaired.queue[next], &impaired.queue[next + 1],
+                        (--impaired.count - next) * sizeof(impaired.queue[0]));
+                return len;
+            }
+            wait = impaired.queue[next].due - now;
+        }
+
+        if (timeout >= 0)
+        {
+            int remaining = timeout - (int)(now - start);
+            if (remaining <= 0)
+                return 0;
+            if (remaining < wait)
+                wait = remaining;
+        }
+
+        impaired_fetch(wait == INT_MAX ? -1 : wait);
+    }
+}
+
+
+const netplay_transport_t *netplay_transport_impaired(const netplay_transport_t *inner, int delay, int jitter, int loss)
+{
+    static const netplay_transport_t transport = {&impaired_open, &impaired_close, &impaired_send, &impaired_receive};
+
+    impaired.inner = inner;
+    impaired.delay = delay;
+    impaired.jitter = jitter;
+    impaired.loss = loss;
+
+    printf("netplay: Simulating %dms delay, %dms jitter, %d%% loss\n", delay, jitter, loss);
+
+    return &transport;
+}
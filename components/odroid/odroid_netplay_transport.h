@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest datagram a transport has to carry
+#define NETPLAY_TRANSPORT_MTU 256
+
+// Packet layer used by netplay. Addresses are IPv4 in network byte order.
+// This file only depends on POSIX so that transports can also run on a host.
+typedef struct {
+    bool (*open)(void);
+    void (*close)(void);
+    bool (*send)(uint32_t addr, const void *data, size_t len);
+    // Returns the length received, 0 on timeout (ms, negative blocks) or -1
+    int  (*receive)(void *data, size_t size, int timeout);
+} netplay_transport_t;
+
+const netplay_transport_t *netplay_transport_udp(uint16_t local_port, uint16_t remote_port);
+const netplay_transport_t *netplay_transport_impaired(const netplay_transport_t *inner, int delay, int jitter, int loss);
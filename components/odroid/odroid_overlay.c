@@ -3,7 +3,9 @@
 #include "odroid_system.h"
 #include "esp_heap_caps.h"
 #include "esp_system.h"
+#include "sys/stat.h"
 #include "unistd.h"
+#include "time.h"
 #include "stdlib.h"
 #include "string.h"
 #include "stdio.h"
@@ -317,6 +319,9 @@ int odroid_overlay_dialog(const char *header, odroid_dialog_choice_t *options, i
 
     odroid_input_wait_for_key(last_key, false);
 
+    // Whatever the menu changed is written in one go
+    odroid_settings_commit();
+
     forceVideoRefresh = true;
 
     return sel < 0 ? sel : options[sel].id;
@@ -439,6 +444,19 @@ bool speedup_update_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t eve
     return event == ODROID_DIALOG_ENTER;
 }
 
+static bool rewind_update_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t event)
+{
+    bool enabled = odroid_system_rewind_enabled();
+
+    if (event == ODROID_DIALOG_PREV || event == ODROID_DIALOG_NEXT) {
+        enabled = odroid_system_rewind_enable(!enabled);
+        odroid_settings_Rewind_set(enabled);
+    }
+
+    strcpy(option->value, enabled ? "On " : "Off");
+    return event == ODROID_DIALOG_ENTER;
+}
+
 int odroid_overlay_settings_menu(odroid_dialog_choice_t *extra_options)
 {
     odroid_audio_mute(true);
@@ -469,6 +487,7 @@ int odroid_overlay_game_settings_menu(odroid_dialog_choice_t *extra_options)
         {10, "Scaling", "Full", 1, &scaling_update_cb},
         {12, "Filtering", "None", 1, &filter_update_cb}, // Interpolation
         {13, "Speed", "1x", 1, &speedup_update_cb},
+        {14, "Rewind", "Off", 1, &rewind_update_cb},
         ODROID_DIALOG_CHOICE_LAST
     };
 
@@ -481,6 +500,34 @@ int odroid_overlay_game_settings_menu(odroid_dialog_choice_t *extra_options)
     return odroid_overlay_settings_menu(options);
 }
 
+static int slot_select_dialog(const char *header, bool load)
+{
+    odroid_dialog_choice_t choices[ODROID_SAVE_STATE_SLOTS + 1];
+    struct stat st;
+
+    // Make sure the timestamps include a save still being written
+    odroid_system_emu_flush_state();
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+
+    for (int i = 0; i < ODROID_SAVE_STATE_SLOTS; i++)
+    {
+        char *path = odroid_system_get_path(NULL, ODROID_PATH_SAVE_STATE + i);
+        bool exists = stat(path, &st) == 0;
+        free(path);
+
+        choices[i] = (odroid_dialog_choice_t){i, "", "Empty", !load || exists, NULL};
+        sprintf(choices[i].label, i == 0 ? "Slot %d (resume)" : "Slot %d", i);
+        if (exists) {
+            strftime(choices[i].value, sizeof(choices[i].value), "%y-%m-%d %H:%M", localtime(&st.st_mtime));
+        }
+    }
+    choices[ODROID_SAVE_STATE_SLOTS] = (odroid_dialog_choice_t)ODROID_DIALOG_CHOICE_LAST;
+
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+    return odroid_overlay_dialog(header, choices, 0);
+}
+
 int odroid_overlay_game_menu()
 {
     odroid_audio_mute(true);
@@ -501,12 +548,19 @@ int odroid_overlay_game_menu()
     };
 
     int r = odroid_overlay_dialog("Retro-Go", choices, 0);
+    int slot;
 
     switch (r)
     {
-        case 10: odroid_system_emu_save_state(0); break;
+        case 10:
+            if ((slot = slot_select_dialog("Save to", false)) >= 0)
+                odroid_system_emu_save_state(slot);
+            break;
         case 20: odroid_system_emu_save_state(0); odroid_system_switch_app(0); break;
-        case 30: odroid_system_emu_load_state(0); break; // esp_restart();
+        case 30:
+            if ((slot = slot_select_dialog("Load from", true)) >= 0)
+                odroid_system_emu_load_state(slot); // esp_restart();
+            break;
         case 40: odroid_netplay_quick_start(); break;
         case 50: odroid_system_switch_app(0); break;
     }
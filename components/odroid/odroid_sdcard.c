@@ -1,14 +1,22 @@
+#define _GNU_SOURCE // fopencookie
 #include "odroid_sdcard.h"
 #include "odroid_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_vfs_fat.h"
 #include "driver/sdmmc_host.h"
 #include "driver/sdspi_host.h"
+#include "sdmmc_cmd.h"
+#include "diskio.h"
+#include "soc/soc_memory_layout.h"
 #include <dirent.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "../miniz/miniz.h"
 
@@ -17,12 +25,120 @@
 #define SPI_PIN_NUM_CLK  GPIO_NUM_18
 #define SPI_PIN_NUM_CS   GPIO_NUM_22
 
+// Deflated files: magic, uncompressed size, then a raw deflate stream
+#define DEFLATE_HEADER_SIZE 8
+#define DEFLATE_FLAGS       (1 | TDEFL_GREEDY_PARSING_FLAG)
+#define INFLATE_CHUNK_SIZE  4096
+
+// File reads are issued in chunks of this size, a multiple of any FAT cluster
+// size up to 32KB so that the driver transfers whole clusters
+#define READ_CHUNK_SIZE     (32 * 1024)
+
+// Longest write done while holding the spi lock, the display waits on it
+#define WRITE_SLICE_SIZE    (16 * 1024)
+
+#define SPEED_TEST_MAX_SIZE (4 * 1024 * 1024)
+#define SPEED_TEST_RANDOM_SIZE  (16 * 1024)
+#define SPEED_TEST_RANDOM_READS 64
+
+typedef struct
+{
+    int fd;
+    char *buffer;
+} stream_t;
+
+// Zip entries are inflated by miniz's iterator, which reads the archive in
+// blocks of MZ_ZIP_MAX_IO_BUF_SIZE. While one block is being inflated the
+// ahead task is already reading the next one from the card.
+struct odroid_zip
+{
+    mz_zip_archive archive;
+    mz_zip_reader_extract_iter_state *iter;
+    mz_uint index;
+    uint32_t crc32; // Of the whole entry, from the central directory
+    size_t size;    // Uncompressed size of the entry
+    size_t pos;     // Offset the iterator is at in the entry
+    bool streaming; // Reads are coming from the iterator
+    int fd;
+    struct {
+        TaskHandle_t task;
+        SemaphoreHandle_t request, done;
+        uint8_t *buffer;
+        size_t offset, length, result;
+        bool pending, started;
+    } ahead;
+};
+
 static bool sdcardOpen = false;
+static bool sdcardHighSpeed = false;
+static sdmmc_host_t sdcardHost;
+static sdmmc_card_t* sdcardCard;
+static odroid_sdcard_stats_t streamStats;
+
+
+// Drops out of high speed mode after a transfer failed in it, returns true
+// if the transfer is worth retrying
+static bool sdcard_fallback(esp_err_t err)
+{
+    if (!sdcardHighSpeed)
+        return false;
+
+    printf("%s: Transfer failed at high speed (%d), falling back.\n", __func__, err);
+
+    sdcardHighSpeed = false;
+    sdcardCard->host.max_freq_khz = SDMMC_FREQ_DEFAULT;
+    sdcardHost.set_card_clk(sdcardHost.slot, SDMMC_FREQ_DEFAULT);
+    odroid_settings_SDHighSpeed_set(0);
+    odroid_settings_commit(); // Don't come back at high speed if we crash
+
+    return true;
+}
+
+// Same as the driver's sdmmc disk access functions, plus the fallback
+static DSTATUS sdcard_disk_status(BYTE pdrv)
+{
+    return 0;
+}
+
+static DRESULT sdcard_disk_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
+{
+    esp_err_t err = sdmmc_read_sectors(sdcardCard, buff, sector, count);
+    if (err != ESP_OK && sdcard_fallback(err))
+        err = sdmmc_read_sectors(sdcardCard, buff, sector, count);
+    return err == ESP_OK ? RES_OK : RES_ERROR;
+}
+
+static DRESULT sdcard_disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
+{
+    esp_err_t err = sdmmc_write_sectors(sdcardCard, buff, sector, count);
+    if (err != ESP_OK && sdcard_fallback(err))
+        err = sdmmc_write_sectors(sdcardCard, buff, sector, count);
+    return err == ESP_OK ? RES_OK : RES_ERROR;
+}
 
+static DRESULT sdcard_disk_ioctl(BYTE pdrv, BYTE cmd, void* buff)
+{
+    switch (cmd)
+    {
+        case CTRL_SYNC:
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            *((DWORD*)buff) = sdcardCard->csd.capacity;
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *((WORD*)buff) = sdcardCard->csd.sector_size;
+            return RES_OK;
+    }
+    return RES_ERROR;
+}
 
 esp_err_t odroid_sdcard_open()
 {
+    static const ff_diskio_impl_t disk_impl = {
+        &sdcard_disk_status, &sdcard_disk_status, &sdcard_disk_read, &sdcard_disk_write, &sdcard_disk_ioctl
+    };
     esp_err_t ret;
+    BYTE pdrv;
 
     if (sdcardOpen)
     {
@@ -33,7 +149,6 @@ esp_err_t odroid_sdcard_open()
     {
         sdmmc_host_t host = SDSPI_HOST_DEFAULT();
     	host.slot = HSPI_HOST; // HSPI_HOST;
-    	//host.max_freq_khz = SDMMC_FREQ_HIGHSPEED; //10000000;
         host.max_freq_khz = SDMMC_FREQ_DEFAULT;
 
     	sdspi_slot_config_t slot_config = SDSPI_SLOT_CONFIG_DEFAULT();
@@ -52,17 +167,46 @@ esp_err_t odroid_sdcard_open()
     	mount_config.format_if_mount_failed = false;
     	mount_config.max_files = 5;
 
+        // High speed is opt-in, not every card or slot copes with it. If it
+        // fails now we mount at the default speed, if it fails later the
+        // disk functions fall back on their own.
+        if (odroid_settings_SDHighSpeed_get())
+        {
+            host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+            sdcardHighSpeed = true;
+        }
+
+        // The drive the mount is about to use, to hook the disk functions
+        if (ff_diskio_get_drive(&pdrv) != ESP_OK)
+        {
+            pdrv = 0xFF;
+        }
 
     	// Use settings defined above to initialize SD card and mount FAT filesystem.
     	// Note: esp_vfs_fat_sdmmc_mount is an all-in-one convenience function.
     	// Please check its source code and implement error recovery when developing
     	// production applications.
-    	sdmmc_card_t* card;
-    	ret = esp_vfs_fat_sdmmc_mount(SD_BASE_PATH, &host, &slot_config, &mount_config, &card);
+    	ret = esp_vfs_fat_sdmmc_mount(SD_BASE_PATH, &host, &slot_config, &mount_config, &sdcardCard);
+
+        if (ret != ESP_OK && sdcardHighSpeed)
+        {
+            printf("odroid_sdcard_open: high speed mount failed (%d), retrying.\n", ret);
+            host.max_freq_khz = SDMMC_FREQ_DEFAULT;
+            sdcardHighSpeed = false;
+            ret = esp_vfs_fat_sdmmc_mount(SD_BASE_PATH, &host, &slot_config, &mount_config, &sdcardCard);
+        }
 
     	if (ret == ESP_OK)
         {
+            sdcardHost = host;
             sdcardOpen = true;
+
+            if (pdrv != 0xFF)
+            {
+                ff_diskio_register(pdrv, &disk_impl);
+            }
+
+            printf("odroid_sdcard_open: mounted at %dKHz.\n", host.max_freq_khz);
         }
         else
         {
@@ -103,55 +247,767 @@ size_t odroid_sdcard_get_filesize(const char* path)
     return 0;
 }
 
+// The driver moves memory it can't DMA to or from one sector at a time. Such
+// transfers go through a small internal bounce buffer instead, so that whole
+// clusters are still moved at once. Without one they are simply slower.
+static bool sdcard_needs_bounce(const void *buf, size_t size)
+{
+    return size >= 512 && !(esp_ptr_dma_capable(buf) && ((intptr_t)buf & 3) == 0);
+}
+
+static ssize_t sdcard_read(int fd, void *buf, size_t size)
+{
+    uint8_t *bounce = sdcard_needs_bounce(buf, size) ? heap_caps_malloc(MIN(size, READ_CHUNK_SIZE), MEM_DMA) : NULL;
+    ssize_t count = 0;
+    size_t ret = 0;
+
+    if (!bounce)
+        return read(fd, buf, size);
+
+    while (ret < size)
+    {
+        size_t len = MIN(READ_CHUNK_SIZE, size - ret);
+
+        if ((count = read(fd, bounce, len)) <= 0)
+            break;
+
+        memcpy((uint8_t*)buf + ret, bounce, count);
+        ret += count;
+
+        if (count < len)
+            break;
+    }
+
+    free(bounce);
+
+    return (count < 0 && ret == 0) ? -1 : ret;
+}
+
+static ssize_t sdcard_write(int fd, const void *buf, size_t size)
+{
+    uint8_t *bounce = sdcard_needs_bounce(buf, size) ? heap_caps_malloc(MIN(size, READ_CHUNK_SIZE), MEM_DMA) : NULL;
+    ssize_t count = 0;
+    size_t ret = 0;
+
+    if (!bounce)
+        return write(fd, buf, size);
+
+    while (ret < size)
+    {
+        size_t len = MIN(READ_CHUNK_SIZE, size - ret);
+
+        memcpy(bounce, (uint8_t*)buf + ret, len);
+
+        if ((count = write(fd, bounce, len)) <= 0)
+            break;
+
+        ret += count;
+
+        if (count < len)
+            break;
+    }
+
+    free(bounce);
+
+    return (count < 0 && ret == 0) ? -1 : ret;
+}
+
 size_t odroid_sdcard_copy_file_to_memory(const char* path, void* buf, size_t buf_size)
 {
     assert(sdcardOpen == true);
 
-    FILE* f = fopen(path, "rb");
-    if (f)
+    // The driver reads sector by sector into memory it can't DMA to, it's
+    // much faster to go through a bounce buffer
+    bool direct = esp_ptr_dma_capable(buf) && ((intptr_t)buf & 3) == 0;
+    uint8_t *bounce = direct ? NULL : heap_caps_malloc(READ_CHUNK_SIZE, MEM_DMA);
+    ssize_t count = 0;
+    size_t ret = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("%s: open failed. path='%s'\n", __func__, path);
+        free(bounce);
+        return 0;
+    }
+
+    while (ret < buf_size)
+    {
+        size_t len = MIN(READ_CHUNK_SIZE, buf_size - ret);
+
+        if ((count = read(fd, bounce ?: (uint8_t*)buf + ret, len)) <= 0)
+            break;
+
+        if (bounce)
+            memcpy((uint8_t*)buf + ret, bounce, count);
+
+        ret += count;
+
+        if (count < len)
+            break;
+    }
+
+    if (count < 0)
+    {
+        printf("%s: read failed at %d. path='%s'\n", __func__, ret, path);
+    }
+
+    close(fd);
+    free(bounce);
+
+    return ret;
+}
+
+odroid_sdcard_speed_t odroid_sdcard_speed_test(const char* path)
+{
+    assert(sdcardOpen == true);
+
+    odroid_sdcard_speed_t ret = {0, 0, sdcardHost.max_freq_khz};
+    uint8_t *buffer = heap_caps_malloc(READ_CHUNK_SIZE, MEM_DMA);
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (buffer && fd >= 0 && fstat(fd, &st) == 0 && st.st_size >= SPEED_TEST_RANDOM_SIZE)
+    {
+        size_t size = MIN(st.st_size, SPEED_TEST_MAX_SIZE), total = 0;
+        size_t blocks = size / SPEED_TEST_RANDOM_SIZE;
+        ssize_t count;
+
+        odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+
+        uint start = get_elapsed_time();
+        while (total < size && (count = read(fd, buffer, MIN(READ_CHUNK_SIZE, size - total))) > 0)
+        {
+            total += count;
+        }
+        ret.sequential = (float)total / MAX(1, get_elapsed_time_since(start)); // B/us = MB/s
+
+        total = 0;
+        start = get_elapsed_time();
+        for (int i = 0; i < SPEED_TEST_RANDOM_READS; i++)
+        {
+            off_t offset = (rand() % blocks) * SPEED_TEST_RANDOM_SIZE;
+            if (lseek(fd, offset, SEEK_SET) != offset
+                || read(fd, buffer, SPEED_TEST_RANDOM_SIZE) != SPEED_TEST_RANDOM_SIZE)
+                break;
+            total += SPEED_TEST_RANDOM_SIZE;
+        }
+        ret.random = (float)total / MAX(1, get_elapsed_time_since(start));
+
+        odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+    }
+
+    if (fd >= 0) close(fd);
+    free(buffer);
+
+    printf("%s: %.2f MB/s sequential, %.2f MB/s random 16KB at %dKHz. path='%s'\n",
+        __func__, ret.sequential, ret.random, ret.freq_khz, path);
+
+    return ret;
+}
+
+static size_t zip_pread(odroid_zip_t *zip, size_t offset, void *buf, size_t size)
+{
+    size_t ret = 0;
+    ssize_t count;
+
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+
+    if (lseek(zip->fd, offset, SEEK_SET) == offset)
     {
-        size_t BLOCK_SIZE = MIN(4096, buf_size);
-        size_t ret = 0, count = 0;
-        do {
-            count = fread(buf + ret, 1, BLOCK_SIZE, f);
+        while (ret < size && (count = sdcard_read(zip->fd, (uint8_t*)buf + ret, size - ret)) > 0)
             ret += count;
-        } while (count == BLOCK_SIZE && ret < buf_size);
+    }
 
-        fclose(f);
-        return ret;
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+    return ret;
+}
+
+static void zip_ahead_task(void *arg)
+{
+    odroid_zip_t *zip = (odroid_zip_t*)arg;
+
+    // A request of length 0 means we're done
+    while (xSemaphoreTake(zip->ahead.request, portMAX_DELAY) == pdPASS && zip->ahead.length > 0)
+    {
+        zip->ahead.result = zip_pread(zip, zip->ahead.offset, zip->ahead.buffer, zip->ahead.length);
+        xSemaphoreGive(zip->ahead.done);
     }
 
-    printf("%s: fopen failed. path='%s'\n", __func__, path);
-    return 0;
+    xSemaphoreGive(zip->ahead.done);
+    vTaskDelete(NULL);
+}
+
+static void zip_ahead_wait(odroid_zip_t *zip)
+{
+    if (zip->ahead.pending)
+    {
+        xSemaphoreTake(zip->ahead.done, portMAX_DELAY);
+        zip->ahead.pending = false;
+    }
 }
 
-size_t odroid_sdcard_unzip_file_to_memory(const char* path, void* buf, size_t buf_size)
+static size_t zip_read_func(void *opaque, mz_uint64 file_ofs, void *buf, size_t size)
+{
+    odroid_zip_t *zip = (odroid_zip_t*)opaque;
+    size_t offset = file_ofs, ret = 0;
+
+    zip_ahead_wait(zip);
+
+    if (zip->ahead.offset == offset)
+    {
+        ret = MIN(size, zip->ahead.result);
+        memcpy(buf, zip->ahead.buffer, ret);
+    }
+
+    if (ret < size)
+    {
+        ret += zip_pread(zip, offset + ret, (uint8_t*)buf + ret, size - ret);
+    }
+
+    // The iterator reads the entry's data sequentially, queue up its next block
+    if (zip->streaming && zip->ahead.task && ret == size && zip->iter->comp_remaining > size)
+    {
+        zip->ahead.offset = offset + size;
+        zip->ahead.length = MIN(MZ_ZIP_MAX_IO_BUF_SIZE, zip->iter->comp_remaining - size);
+        zip->ahead.result = 0;
+        zip->ahead.pending = true;
+        xSemaphoreGive(zip->ahead.request);
+    }
+    else
+    {
+        zip->ahead.offset = SIZE_MAX;
+    }
+
+    return ret;
+}
+
+static bool zip_match_ext(const char *name, const char *exts)
+{
+    const char *ext = odroid_sdcard_get_extension(name);
+    size_t len = ext ? strlen(ext) : 0;
+
+    for (const char *p = exts; p && len > 0; p = strchr(p, ','))
+    {
+        if (*p == ',') p++;
+        if (strncasecmp(p, ext, len) == 0 && (p[len] == ',' || p[len] == 0))
+            return true;
+    }
+
+    return false;
+}
+
+static bool zip_rewind(odroid_zip_t *zip)
+{
+    if (zip->iter)
+    {
+        mz_zip_reader_extract_iter_free(zip->iter);
+    }
+
+    zip->iter = mz_zip_reader_extract_iter_new(&zip->archive, zip->index, 0);
+    zip->pos = 0;
+
+    return zip->iter != NULL;
+}
+
+odroid_zip_t* odroid_sdcard_zip_open(const char* path, const char* exts)
 {
     assert(sdcardOpen == true);
 
+    mz_zip_archive_file_stat file_stat;
+    bool found = false, matched = false;
+    struct stat st;
+
+    odroid_zip_t *zip = calloc(1, sizeof(odroid_zip_t));
+    if (!zip)
+        return NULL;
+
+    zip->archive.m_pRead = &zip_read_func;
+    zip->archive.m_pIO_opaque = zip;
+    zip->ahead.offset = SIZE_MAX;
+
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+    zip->fd = open(path, O_RDONLY);
+    if (zip->fd >= 0 && fstat(zip->fd, &st) != 0)
+    {
+        close(zip->fd);
+        zip->fd = -1;
+    }
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+    if (zip->fd < 0 || !mz_zip_reader_init(&zip->archive, st.st_size, 0))
+    {
+        printf("%s: Not a zip archive. path='%s'\n", __func__, path);
+        odroid_sdcard_zip_close(zip);
+        return NULL;
+    }
+
+    // Prefer the entries with one of the extensions wanted, then the largest
+    for (mz_uint i = 0; i < mz_zip_reader_get_num_files(&zip->archive); i++)
+    {
+        if (!mz_zip_reader_file_stat(&zip->archive, i, &file_stat)
+            || file_stat.m_is_directory || !file_stat.m_is_supported)
+            continue;
+
+        bool match = zip_match_ext(file_stat.m_filename, exts);
+
+        if (!found || (match && !matched) || (match == matched && file_stat.m_uncomp_size > zip->size))
+        {
+            zip->index = i;
+            zip->crc32 = file_stat.m_crc32;
+            zip->size = file_stat.m_uncomp_size;
+            matched = match;
+            found = true;
+        }
+    }
+
+    if (!found)
+    {
+        printf("%s: No usable entry. path='%s'\n", __func__, path);
+        odroid_sdcard_zip_close(zip);
+        return NULL;
+    }
+
+    mz_zip_reader_file_stat(&zip->archive, zip->index, &file_stat);
+    printf("%s: Using entry %s (%d bytes) of %s\n", __func__, file_stat.m_filename, zip->size, path);
+
+    return zip;
+}
+
+// Without the ahead task reads are simply done in line
+static void zip_ahead_start(odroid_zip_t *zip)
+{
+    zip->ahead.started = true;
+    // Internal RAM is too scarce for 64KB, zip_pread bounces PSRAM reads
+    zip->ahead.buffer = heap_caps_malloc(MZ_ZIP_MAX_IO_BUF_SIZE, MEM_SLOW);
+    if (!zip->ahead.buffer)
+        zip->ahead.buffer = heap_caps_malloc(MZ_ZIP_MAX_IO_BUF_SIZE, MEM_ANY);
+    zip->ahead.request = xSemaphoreCreateBinary();
+    zip->ahead.done = xSemaphoreCreateBinary();
+
+    if (!zip->ahead.buffer || !zip->ahead.request || !zip->ahead.done
+        || xTaskCreatePinnedToCore(&zip_ahead_task, "zip_ahead", 3072, zip, 5, &zip->ahead.task, 1) != pdPASS)
+    {
+        printf("%s: Reading ahead is disabled.\n", __func__);
+        zip->ahead.task = NULL;
+    }
+}
+
+size_t odroid_sdcard_zip_read(odroid_zip_t* zip, size_t offset, void* buf, size_t size)
+{
+    size_t ret = 0, count;
+
+    // Not worth it for a header
+    if (!zip->ahead.started && offset + size > MZ_ZIP_MAX_IO_BUF_SIZE)
+    {
+        zip_ahead_start(zip);
+    }
+
+    if (offset < zip->pos || !zip->iter)
+    {
+        if (zip->iter)
+            printf("%s: Rewinding from %d to %d\n", __func__, zip->pos, offset);
+        if (!zip_rewind(zip))
+            return 0;
+    }
+
+    zip->streaming = true;
+
+    // Inflating is sequential, whatever comes before offset goes through buf
+    while (zip->pos < offset && (count = mz_zip_reader_extract_iter_read(zip->iter, buf, MIN(size, offset - zip->pos))) > 0)
+    {
+        zip->pos += count;
+    }
+
+    if (zip->pos == offset)
+    {
+        ret = mz_zip_reader_extract_iter_read(zip->iter, buf, size);
+        zip->pos += ret;
+    }
+
+    zip->streaming = false;
+
+    return ret;
+}
+
+// Multiplication modulo the crc32 polynomial, bit 31 being x^0
+static uint32_t crc32_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1u << 31, p = 0;
+
+    for (; m; m >>= 1)
+    {
+        if (a & m)
+            p ^= b;
+        b = (b & 1) ? (b >> 1) ^ 0xEDB88320 : b >> 1;
+    }
+
+    return p;
+}
+
+// What crc becomes after len more zero bytes, minus the conditioning
+static uint32_t crc32_shift(uint32_t crc, size_t len)
+{
+    uint32_t p = 1u << 31, sq = 1u << 23; // x^0, x^8
+
+    for (; len; len >>= 1)
+    {
+        if (len & 1)
+            p = crc32_multmodp(sq, p);
+        sq = crc32_multmodp(sq, sq);
+    }
+
+    return crc32_multmodp(p, crc);
+}
+
+uint32_t odroid_sdcard_zip_crc32(odroid_zip_t* zip, size_t skip)
+{
+    if (skip == 0)
+        return zip->crc32;
+
+    if (skip >= zip->size)
+        return 0;
+
+    // crc(header + data) = shift(crc(header), len(data)) ^ crc(data), so only
+    // the header has to be inflated to take it out
+    uint8_t *header = malloc(skip);
+    uint32_t crc = 0;
+
+    if (header && odroid_sdcard_zip_read(zip, 0, header, skip) == skip)
+    {
+        crc = zip->crc32 ^ crc32_shift(mz_crc32(MZ_CRC32_INIT, header, skip), zip->size - skip);
+    }
+
+    free(header);
+
+    return crc;
+}
+
+size_t odroid_sdcard_zip_tell(odroid_zip_t* zip)
+{
+    return zip->pos;
+}
+
+size_t odroid_sdcard_zip_size(odroid_zip_t* zip)
+{
+    return zip->size;
+}
+
+void odroid_sdcard_zip_close(odroid_zip_t* zip)
+{
+    if (!zip)
+        return;
+
+    zip_ahead_wait(zip);
+
+    if (zip->ahead.task)
+    {
+        zip->ahead.length = 0;
+        xSemaphoreGive(zip->ahead.request);
+        xSemaphoreTake(zip->ahead.done, portMAX_DELAY);
+    }
+
+    if (zip->iter) mz_zip_reader_extract_iter_free(zip->iter);
+    if (zip->ahead.request) vSemaphoreDelete(zip->ahead.request);
+    if (zip->ahead.done) vSemaphoreDelete(zip->ahead.done);
+    if (zip->fd >= 0) close(zip->fd);
+
+    mz_zip_reader_end(&zip->archive);
+    free(zip->ahead.buffer);
+    free(zip);
+}
+
+size_t odroid_sdcard_unzip_file_to_memory(const char* path, const char* exts, void* buf, size_t buf_size)
+{
     size_t ret = 0;
 
-    mz_zip_archive zip_archive;
-    memset(&zip_archive, 0, sizeof(zip_archive));
+    odroid_zip_t *zip = odroid_sdcard_zip_open(path, exts);
+    if (zip)
+    {
+        if (zip->size <= buf_size && odroid_sdcard_zip_read(zip, 0, buf, zip->size) == zip->size)
+        {
+            // Freeing the iterator also checks the crc32 of a complete read
+            ret = mz_zip_reader_extract_iter_free(zip->iter) ? zip->size : 0;
+            zip->iter = NULL;
+        }
+        odroid_sdcard_zip_close(zip);
+    }
 
-    if (mz_zip_reader_init_file(&zip_archive, path, 0))
+    if (ret == 0)
     {
-        printf("%s: Opened archive %s\n", __func__, path);
-        mz_zip_archive_file_stat file_stat;
-        if (mz_zip_reader_file_stat(&zip_archive, 0, &file_stat))
+        printf("%s: failed. path='%s'\n", __func__, path);
+    }
+
+    return ret;
+}
+
+typedef struct
+{
+    uint8_t *buffer;
+    size_t size;
+    size_t capacity;
+} deflate_output_t;
+
+static mz_bool deflate_put_buf(const void* buf, int len, void *user)
+{
+    deflate_output_t *out = (deflate_output_t*)user;
+    if (out->size + len > out->capacity)
+        return MZ_FALSE;
+    memcpy(out->buffer + out->size, buf, len);
+    out->size += len;
+    return MZ_TRUE;
+}
+
+size_t odroid_sdcard_deflate_memory(const void* buf, size_t size, void** out)
+{
+    uint32_t header[2] = {ODROID_SDCARD_DEFLATE_MAGIC, size};
+    size_t ret = 0;
+
+    // Large enough for incompressible data, which is stored in raw blocks
+    deflate_output_t dest = {NULL, DEFLATE_HEADER_SIZE, DEFLATE_HEADER_SIZE + mz_compressBound(size)};
+    tdefl_compressor *deflator = heap_caps_malloc(sizeof(tdefl_compressor), MEM_SLOW);
+    dest.buffer = heap_caps_malloc(dest.capacity, MEM_SLOW);
+
+    if (deflator && dest.buffer)
+    {
+        memcpy(dest.buffer, header, DEFLATE_HEADER_SIZE);
+        tdefl_init(deflator, &deflate_put_buf, &dest, DEFLATE_FLAGS);
+        if (tdefl_compress_buffer(deflator, buf, size, TDEFL_FINISH) == TDEFL_STATUS_DONE)
         {
-            printf("%s: Extracting file %s\n", __func__, file_stat.m_filename);
-            if (mz_zip_reader_extract_to_mem(&zip_archive, 0, buf, buf_size, 0))
+            ret = dest.size;
+        }
+    }
+
+    free(deflator);
+
+    if (ret == 0)
+    {
+        printf("%s: failed. size=%d\n", __func__, size);
+        free(dest.buffer);
+        dest.buffer = NULL;
+    }
+
+    *out = dest.buffer;
+
+    return ret;
+}
+
+size_t odroid_sdcard_write_memory_to_file(const char* path, const void* buf, size_t size)
+{
+    assert(sdcardOpen == true);
+
+    size_t ret = 0;
+
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+    if (fd < 0)
+    {
+        printf("%s: open failed. path='%s'\n", __func__, path);
+        return 0;
+    }
+
+    while (ret < size)
+    {
+        size_t len = MIN(WRITE_SLICE_SIZE, size - ret);
+
+        odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+        ssize_t count = sdcard_write(fd, (uint8_t*)buf + ret, len);
+        odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+        if (count != len)
+            break;
+
+        ret += count;
+
+        // Let the display through if it's waiting
+        taskYIELD();
+    }
+
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+    if (close(fd) != 0)
+        ret = 0;
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+    if (ret < size)
+    {
+        printf("%s: write failed at %d. path='%s'\n", __func__, ret, path);
+        return 0;
+    }
+
+    return ret;
+}
+
+size_t odroid_sdcard_deflate_memory_to_file(const char* path, const void* buf, size_t size)
+{
+    void *data = NULL;
+    size_t ret = odroid_sdcard_deflate_memory(buf, size, &data);
+
+    if (ret > 0)
+    {
+        ret = odroid_sdcard_write_memory_to_file(path, data, ret);
+    }
+
+    free(data);
+
+    return ret;
+}
+
+size_t odroid_sdcard_inflate_file_to_memory(const char* path, void* buf, size_t buf_size)
+{
+    assert(sdcardOpen == true);
+
+    uint32_t header[2] = {0, 0};
+    size_t ret = 0;
+
+    FILE* f = odroid_sdcard_fopen(path, "rb");
+    if (!f)
+    {
+        printf("%s: fopen failed. path='%s'\n", __func__, path);
+        return 0;
+    }
+
+    if (fread(header, DEFLATE_HEADER_SIZE, 1, f) != 1 || header[0] != ODROID_SDCARD_DEFLATE_MAGIC)
+    {
+        // Not one of ours, read it as is
+        fclose(f);
+        return odroid_sdcard_copy_file_to_memory(path, buf, buf_size);
+    }
+
+    tinfl_decompressor *inflator = malloc(sizeof(tinfl_decompressor));
+    uint8_t *chunk = malloc(INFLATE_CHUNK_SIZE);
+
+    if (inflator && chunk && header[1] <= buf_size)
+    {
+        tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+        size_t out_pos = 0;
+
+        tinfl_init(inflator);
+
+        while (status == TINFL_STATUS_NEEDS_MORE_INPUT)
+        {
+            size_t in_size = fread(chunk, 1, INFLATE_CHUNK_SIZE, f);
+            size_t in_pos = 0;
+
+            do
             {
-                ret = file_stat.m_uncomp_size;
+                size_t in_left = in_size - in_pos;
+                size_t out_left = header[1] - out_pos;
+
+                status = tinfl_decompress(inflator, chunk + in_pos, &in_left, buf, (uint8_t*)buf + out_pos, &out_left,
+                    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | (feof(f) ? 0 : TINFL_FLAG_HAS_MORE_INPUT));
+
+                in_pos += in_left;
+                out_pos += out_left;
             }
+            while (status == TINFL_STATUS_NEEDS_MORE_INPUT && in_pos < in_size);
+
+            if (in_size == 0)
+                break;
+        }
+
+        if (status == TINFL_STATUS_DONE && out_pos == header[1])
+        {
+            ret = out_pos;
         }
-        mz_zip_reader_end(&zip_archive);
     }
 
+    free(inflator);
+    free(chunk);
+    fclose(f);
+
+    if (ret == 0)
+    {
+        printf("%s: failed. path='%s'\n", __func__, path);
+    }
+
+    return ret;
+}
+
+static ssize_t stream_read(void *cookie, char *buf, size_t size)
+{
+    ssize_t ret = sdcard_read(((stream_t*)cookie)->fd, buf, size);
+    streamStats.reads++;
+    if (ret > 0) streamStats.bytesRead += ret;
+    return ret;
+}
+
+static ssize_t stream_write(void *cookie, const char *buf, size_t size)
+{
+    ssize_t ret = sdcard_write(((stream_t*)cookie)->fd, buf, size);
+    streamStats.writes++;
+    if (ret > 0) streamStats.bytesWritten += ret;
     return ret;
 }
 
+static int stream_seek(void *cookie, off_t *offset, int whence)
+{
+    off_t ret = lseek(((stream_t*)cookie)->fd, *offset, whence);
+    streamStats.seeks++;
+    if (ret < 0) return -1;
+    *offset = ret;
+    return 0;
+}
+
+static int stream_close(void *cookie)
+{
+    stream_t *stream = (stream_t*)cookie;
+    int ret = close(stream->fd);
+    free(stream->buffer);
+    free(stream);
+    return ret;
+}
+
+FILE* odroid_sdcard_fopen(const char* path, const char* mode)
+{
+    assert(sdcardOpen == true);
+
+    cookie_io_functions_t funcs = {&stream_read, &stream_write, &stream_seek, &stream_close};
+    int flags = strchr(mode, '+') ? O_RDWR : (mode[0] == 'r' ? O_RDONLY : O_WRONLY);
+    FILE *fp = NULL;
+
+    if (mode[0] == 'w') flags |= O_CREAT | O_TRUNC;
+    if (mode[0] == 'a') flags |= O_CREAT | O_APPEND;
+
+    stream_t *stream = calloc(1, sizeof(stream_t));
+    if (!stream)
+        return NULL;
+
+    if ((stream->fd = open(path, flags, 0666)) < 0)
+    {
+        free(stream);
+        return NULL;
+    }
+
+    if (!(fp = fopencookie(stream, mode, funcs)))
+    {
+        close(stream->fd);
+        free(stream);
+        return NULL;
+    }
+
+    // PSRAM, several streams can be open and internal RAM is kept for the
+    // emulators. Its transfers are bounced by stream_read and stream_write.
+    // Without a buffer the stream still works, just unbuffered by us.
+    stream->buffer = heap_caps_malloc(ODROID_SDCARD_STREAM_BUFFER_SIZE, MEM_SLOW);
+    if (!stream->buffer)
+        stream->buffer = heap_caps_malloc(ODROID_SDCARD_STREAM_BUFFER_SIZE, MEM_ANY);
+    if (stream->buffer)
+        setvbuf(fp, stream->buffer, _IOFBF, ODROID_SDCARD_STREAM_BUFFER_SIZE);
+
+    return fp;
+}
+
+odroid_sdcard_stats_t odroid_sdcard_get_stats(bool reset)
+{
+    odroid_sdcard_stats_t stats = streamStats;
+    if (reset)
+        memset(&streamStats, 0, sizeof(streamStats));
+    return stats;
+}
+
 const char* odroid_sdcard_get_filename(const char* path)
 {
     const char *name = strrchr(path, '/');
@@ -1,15 +1,73 @@
 #pragma once
 
 #include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #define SD_BASE_PATH "/sd"
 
+// First word of the files written by odroid_sdcard_deflate_memory_to_file
+#define ODROID_SDCARD_DEFLATE_MAGIC 0x315A4752 // "RGZ1"
+
+// Streams returned by odroid_sdcard_fopen coalesce small reads and writes into
+// transfers of this size
+#ifndef ODROID_SDCARD_STREAM_BUFFER_SIZE
+#define ODROID_SDCARD_STREAM_BUFFER_SIZE (32 * 1024)
+#endif
+
+// Calls that reached the filesystem through odroid_sdcard_fopen streams
+typedef struct
+{
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t seeks;
+    uint32_t bytesRead;
+    uint32_t bytesWritten;
+} odroid_sdcard_stats_t;
+
+// Read throughput in MB/s, see odroid_sdcard_speed_test
+typedef struct
+{
+    float sequential;
+    float random;
+    uint32_t freq_khz;
+} odroid_sdcard_speed_t;
+
+// A single entry of a zip archive, inflated as it is read. The entry is the
+// largest one whose extension is in exts ("gb,gbc"), or the largest of all
+// when none match. Reading before the current position restarts inflation
+// from the beginning of the entry. The sd card lock is taken internally and
+// must not be held by the caller.
+typedef struct odroid_zip odroid_zip_t;
+
 esp_err_t odroid_sdcard_open();
 esp_err_t odroid_sdcard_close();
 size_t odroid_sdcard_get_filesize(const char* path);
 size_t odroid_sdcard_copy_file_to_memory(const char* path, void* buf, size_t buf_size);
-size_t odroid_sdcard_unzip_file_to_memory(const char* path, void* buf, size_t buf_size);
+size_t odroid_sdcard_unzip_file_to_memory(const char* path, const char* exts, void* buf, size_t buf_size);
+// Deflates buf into a new PSRAM buffer (*out, to be freed), header included.
+// The sd card isn't touched, returns the deflated size or 0.
+size_t odroid_sdcard_deflate_memory(const void* buf, size_t size, void** out);
+// Both write in slices and take the sd card lock for each of them only, so
+// that the display isn't held up. The caller must not hold the lock.
+size_t odroid_sdcard_write_memory_to_file(const char* path, const void* buf, size_t size);
+size_t odroid_sdcard_deflate_memory_to_file(const char* path, const void* buf, size_t size);
+size_t odroid_sdcard_inflate_file_to_memory(const char* path, void* buf, size_t buf_size);
 int odroid_sdcard_mkdir(char *dir);
+// Reads up to 4MB of path sequentially, then 16KB blocks of it at random
+odroid_sdcard_speed_t odroid_sdcard_speed_test(const char* path);
+
+odroid_zip_t* odroid_sdcard_zip_open(const char* path, const char* exts);
+size_t odroid_sdcard_zip_read(odroid_zip_t* zip, size_t offset, void* buf, size_t size);
+size_t odroid_sdcard_zip_tell(odroid_zip_t* zip);
+size_t odroid_sdcard_zip_size(odroid_zip_t* zip);
+// crc32 of the entry past its first skip bytes, 0 if it can't be known
+uint32_t odroid_sdcard_zip_crc32(odroid_zip_t* zip, size_t skip);
+void odroid_sdcard_zip_close(odroid_zip_t* zip);
+
+FILE* odroid_sdcard_fopen(const char* path, const char* mode);
+odroid_sdcard_stats_t odroid_sdcard_get_stats(bool reset);
 
 const char* odroid_sdcard_get_filename(const char* path);
 const char* odroid_sdcard_get_extension(const char* path);
\ No newline at end of file
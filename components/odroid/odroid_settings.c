@@ -1,5 +1,7 @@
 #include "odroid_settings.h"
 #include "odroid_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "nvs_flash.h"
 #include "string.h"
 
@@ -16,9 +18,105 @@ static const char* NvsKey_AudioSink = "AudioSink";
 static const char* NvsKey_Palette = "Palette";
 static const char* NvsKey_Region = "Region";
 static const char* NvsKey_DispFilter = "DispFilter";
+static const char* NvsKey_Rewind = "Rewind";
+static const char* NvsKey_CompressSaves = "CompressSaves";
+static const char* NvsKey_SDHighSpeed = "SDHighSpeed";
+
+#define CACHE_SIZE 64
+
+typedef struct
+{
+    char key[16];
+    char *string;
+    int32_t value;
+    bool is_string;
+    bool exists;
+    bool dirty;
+} setting_t;
+
+// Settings are read once from flash and written back in batches, see odroid_settings_commit
+static struct
+{
+    setting_t entries[CACHE_SIZE];
+    int count;
+    int dirty;
+    int64_t changed;
+    uint32_t saved;
+    SemaphoreHandle_t lock;
+} cache;
 
 static nvs_handle my_handle;
 
+// Returns the cache entry of key, loading it from flash if needed. NULL if the cache is full.
+static setting_t *cache_get(const char *key, bool is_string)
+{
+    for (int i = 0; i < cache.count; i++)
+    {
+        if (strcmp(cache.entries[i].key, key) == 0)
+            return &cache.entries[i];
+    }
+
+    if (cache.count == CACHE_SIZE || strlen(key) >= 16)
+    {
+        printf("%s: Not caching key='%s'\n", __func__, key);
+        return NULL;
+    }
+
+    setting_t *entry = &cache.entries[cache.count++];
+    memset(entry, 0, sizeof(setting_t));
+    strcpy(entry->key, key);
+    entry->is_string = is_string;
+
+    esp_err_t err;
+    if (is_string)
+    {
+        size_t required_size;
+        err = nvs_get_str(my_handle, key, NULL, &required_size);
+        if (err == ESP_OK)
+        {
+            entry->string = rg_alloc(required_size, MEM_ANY);
+            err = nvs_get_str(my_handle, key, entry->string, &required_size);
+            if (err != ESP_OK)
+            {
+                free(entry->string);
+                entry->string = NULL;
+            }
+        }
+    }
+    else
+    {
+        err = nvs_get_i32(my_handle, key, &entry->value);
+    }
+
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    {
+        printf("%s: key='%s' err=%d\n", __func__, key, err);
+    }
+
+    entry->exists = (err == ESP_OK);
+
+    return entry;
+}
+
+static void cache_set_dirty(setting_t *entry)
+{
+    entry->exists = true;
+    if (!entry->dirty)
+    {
+        entry->dirty = true;
+        if (cache.dirty++ == 0)
+            cache.changed = get_elapsed_time();
+    }
+}
+
+static esp_err_t cache_write(setting_t *entry)
+{
+    if (entry->is_string)
+        return nvs_set_str(my_handle, entry->key, entry->string);
+    else
+        return nvs_set_i32(my_handle, entry->key, entry->value);
+}
+
 void odroid_settings_init()
 {
     esp_err_t err = nvs_flash_init();
@@ -32,69 +130,182 @@ void odroid_settings_init()
 
 	err = nvs_open(NvsNamespace, NVS_READWRITE, &my_handle);
 	if (err != ESP_OK) abort();
+
+    cache.lock = xSemaphoreCreateMutex();
+
+    // Global settings are read by most apps at boot, load them in one go
+    const char *keys[] = {NvsKey_Volume, NvsKey_VRef, NvsKey_Backlight, NvsKey_StartAction,
+        NvsKey_AudioSink, NvsKey_CompressSaves, NvsKey_SDHighSpeed};
+
+    for (int i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+    {
+        cache_get(keys[i], false);
+    }
+    cache_get(NvsKey_RomFilePath, true);
 }
 
-char* odroid_settings_string_get(const char *key, char *default_value)
+int odroid_settings_commit()
 {
-    char* result = default_value;
+    int written = 0;
 
-    size_t required_size;
-    esp_err_t err = nvs_get_str(my_handle, key, NULL, &required_size);
-    if (err == ESP_OK)
-    {
-        char* value = rg_alloc(required_size, MEM_ANY);
+    xSemaphoreTake(cache.lock, portMAX_DELAY);
 
-        esp_err_t err = nvs_get_str(my_handle, key, value, &required_size);
-        if (err == ESP_OK)
+    if (cache.dirty > 0)
+    {
+        for (int i = 0; i < cache.count; i++)
         {
-            result = value;
+            setting_t *entry = &cache.entries[i];
+            if (!entry->dirty)
+                continue;
+
+            esp_err_t err = cache_write(entry);
+            if (err != ESP_OK)
+            {
+                printf("%s: key='%s' err=%d\n", __func__, entry->key, err);
+            }
+            entry->dirty = false;
+            written++;
         }
+
+        nvs_commit(my_handle);
+        cache.saved--;
+        cache.dirty = 0;
+
+        printf("%s: %d keys written, %d flash writes saved so far\n", __func__, written, cache.saved);
     }
 
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    xSemaphoreGive(cache.lock);
+
+    return written;
+}
+
+int odroid_settings_commit_pending()
+{
+    if (cache.dirty > 0 && get_elapsed_time_since(cache.changed) > ODROID_SETTINGS_COMMIT_DELAY * 1000)
     {
-        printf("%s: key='%s' err=%d\n", __func__, key, err);
+        return odroid_settings_commit();
     }
+    return 0;
+}
+
+uint32_t odroid_settings_get_writes_saved()
+{
+    return cache.saved;
+}
+
+char* odroid_settings_string_get(const char *key, char *default_value)
+{
+    char* result = default_value;
+
+    xSemaphoreTake(cache.lock, portMAX_DELAY);
+
+    setting_t *entry = cache_get(key, true);
+    if (entry && entry->exists)
+    {
+        result = rg_alloc(strlen(entry->string) + 1, MEM_ANY);
+        strcpy(result, entry->string);
+    }
+    else if (!entry)
+    {
+        size_t required_size;
+        if (nvs_get_str(my_handle, key, NULL, &required_size) == ESP_OK)
+        {
+            result = rg_alloc(required_size, MEM_ANY);
+            if (nvs_get_str(my_handle, key, result, &required_size) != ESP_OK)
+            {
+                free(result);
+                result = default_value;
+            }
+        }
+    }
+
+    xSemaphoreGive(cache.lock);
 
     return result;
 }
 
 void odroid_settings_string_set(const char *key, char *value)
 {
-    // To do: Check if value is same and avoid overwrite
-    esp_err_t err = nvs_set_str(my_handle, key, value);
-    if (err != ESP_OK) abort();
+    xSemaphoreTake(cache.lock, portMAX_DELAY);
 
-    nvs_commit(my_handle);
+    setting_t *entry = cache_get(key, true);
+    if (entry)
+    {
+        // Every set used to cost a commit, whether or not the value changed
+        cache.saved++;
+        if (!entry->exists || strcmp(entry->string, value) != 0)
+        {
+            free(entry->string);
+            entry->string = rg_alloc(strlen(value) + 1, MEM_ANY);
+            strcpy(entry->string, value);
+            cache_set_dirty(entry);
+        }
+    }
+    else
+    {
+        esp_err_t err = nvs_set_str(my_handle, key, value);
+        if (err != ESP_OK) abort();
+        nvs_commit(my_handle);
+    }
+
+    xSemaphoreGive(cache.lock);
 }
 
 int32_t odroid_settings_int32_get(const char *key, int32_t default_value)
 {
-    int result = default_value;
+    int32_t result = default_value;
 
-    esp_err_t err = nvs_get_i32(my_handle, key, &result);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    xSemaphoreTake(cache.lock, portMAX_DELAY);
+
+    setting_t *entry = cache_get(key, false);
+    if (entry && entry->exists)
     {
-        printf("%s: key='%s' err=%d\n", __func__, key, err);
+        result = entry->value;
     }
+    else if (!entry)
+    {
+        esp_err_t err = nvs_get_i32(my_handle, key, &result);
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+        {
+            printf("%s: key='%s' err=%d\n", __func__, key, err);
+        }
+    }
+
+    xSemaphoreGive(cache.lock);
+
     return result;
 }
 
 void odroid_settings_int32_set(const char *key, int32_t value)
 {
-    int32_t current = 0;
-    esp_err_t err = ESP_OK;
-    // Don't wear the flash for nothing if we can avoid it
-    if (nvs_get_i32(my_handle, key, &current) != ESP_OK || current != value)
+    xSemaphoreTake(cache.lock, portMAX_DELAY);
+
+    setting_t *entry = cache_get(key, false);
+    if (entry)
     {
-        err = nvs_set_i32(my_handle, key, value);
-        nvs_commit(my_handle);
+        // Don't wear the flash for nothing if we can avoid it
+        if (!entry->exists || entry->value != value)
+        {
+            entry->value = value;
+            cache_set_dirty(entry);
+            cache.saved++;
+        }
     }
-
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    else
     {
-        printf("%s: key='%s' err=%d\n", __func__, key, err);
+        int32_t current = 0;
+        if (nvs_get_i32(my_handle, key, &current) != ESP_OK || current != value)
+        {
+            esp_err_t err = nvs_set_i32(my_handle, key, value);
+            if (err != ESP_OK)
+            {
+                printf("%s: key='%s' err=%d\n", __func__, key, err);
+            }
+            nvs_commit(my_handle);
+        }
     }
+
+    xSemaphoreGive(cache.lock);
 }
 
 int32_t odroid_settings_app_int32_get(const char *key, int32_t default_value)
@@ -221,3 +432,33 @@ void odroid_settings_DisplayFilter_set(int32_t value)
 {
     odroid_settings_app_int32_set(NvsKey_DispFilter, value);
 }
+
+
+int32_t odroid_settings_Rewind_get()
+{
+    return odroid_settings_app_int32_get(NvsKey_Rewind, 0);
+}
+void odroid_settings_Rewind_set(int32_t value)
+{
+    odroid_settings_app_int32_set(NvsKey_Rewind, value);
+}
+
+
+int32_t odroid_settings_CompressSaves_get()
+{
+    return odroid_settings_int32_get(NvsKey_CompressSaves, 1);
+}
+void odroid_settings_CompressSaves_set(int32_t value)
+{
+    odroid_settings_int32_set(NvsKey_CompressSaves, value);
+}
+
+
+int32_t odroid_settings_SDHighSpeed_get()
+{
+    return odroid_settings_int32_get(NvsKey_SDHighSpeed, 0);
+}
+void odroid_settings_SDHighSpeed_set(int32_t value)
+{
+    odroid_settings_int32_set(NvsKey_SDHighSpeed, value);
+}
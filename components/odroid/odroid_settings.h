@@ -22,7 +22,17 @@ typedef enum
     ODROID_REGION_PAL
 } ODROID_REGION;
 
+// Changes are kept in RAM and committed to flash together, at the latest
+// this long (ms) after the first one
+#define ODROID_SETTINGS_COMMIT_DELAY 2000
+
 void odroid_settings_init();
+// Writes all pending changes in one commit, returns the number of keys written
+int odroid_settings_commit();
+// Same but only once the oldest change is ODROID_SETTINGS_COMMIT_DELAY old
+int odroid_settings_commit_pending();
+// Flash commits avoided so far by batching and skipping unchanged values
+uint32_t odroid_settings_get_writes_saved();
 
 int32_t odroid_settings_VRef_get();
 void odroid_settings_VRef_set(int32_t value);
@@ -57,6 +67,15 @@ void odroid_settings_DisplayScaling_set(int32_t value);
 int32_t odroid_settings_DisplayFilter_get();
 void odroid_settings_DisplayFilter_set(int32_t value);
 
+int32_t odroid_settings_Rewind_get();
+void odroid_settings_Rewind_set(int32_t value);
+
+int32_t odroid_settings_CompressSaves_get();
+void odroid_settings_CompressSaves_set(int32_t value);
+
+int32_t odroid_settings_SDHighSpeed_get();
+void odroid_settings_SDHighSpeed_set(int32_t value);
+
 void odroid_settings_string_set(const char *key, char *value);
 char* odroid_settings_string_get(const char *key, char *default_value);
 
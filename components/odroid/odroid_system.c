@@ -8,8 +8,10 @@
 #include "esp_event.h"
 #include "driver/rtc_io.h"
 #include "rom/crc.h"
+#include "../miniz/miniz.h"
 #include "string.h"
 #include "stdio.h"
+#include "sys/param.h"
 
 int8_t speedupEnabled = 0;
 
@@ -20,9 +22,65 @@ static char *romPath = NULL;
 static state_handler_t loadState;
 static state_handler_t saveState;
 static state_handler_t resetState;
+static state_mem_handler_t loadStateMem;
+static state_mem_handler_t saveStateMem;
 
 static SemaphoreHandle_t spiMutex;
+static TaskHandle_t spiMutexTask;
 static int16_t spiMutexOwner;
+static int16_t spiMutexDepth;
+
+// Save state being written to the card by the state writer task
+static struct {
+    char *path;
+    void *buffer;
+    size_t size;
+    volatile bool pending;
+    bool failed;
+    bool compress;
+    QueueHandle_t queue;
+} stateWriter;
+
+// Rewind history: only the newest snapshot is kept whole, older ones are the
+// deflated XOR of two consecutive snapshots, stored newest last in a ring.
+#define REWIND_IDLE  ((size_t)-1)
+#define REWIND_CHUNK 1024
+#define REWIND_TAP_FRAMES 3
+#define REWIND_DEFLATE_FLAGS (1 | TDEFL_GREEDY_PARSING_FLAG)
+
+static struct {
+    bool enabled;
+    bool rewinding;
+    bool valid;
+    bool modifierHeld;
+    bool modifierUsed;
+    int modifierTap;
+    size_t size;
+    uint8_t *state;
+    uint8_t *capture;
+    uint8_t *delta;
+    uint8_t *output;
+    size_t outputUsed;
+    size_t captured;
+    tdefl_compressor *deflator;
+    tinfl_decompressor *inflator;
+    uint8_t *ring;
+    struct {
+        uint32_t offset;
+        uint32_t size;
+    } entries[ODROID_REWIND_MAX_ENTRIES];
+    int first, count;
+    uint32_t head;
+    uint32_t stored;
+    int frames;
+    struct {
+        uint frames;
+        uint time;
+        uint maxTime;
+        uint snapshots;
+        uint bytesOut;
+    } stats;
+} history;
 
 static struct {
     uint total;
@@ -92,6 +150,7 @@ void odroid_system_init(int appId, int sampleRate)
             image_sdcard_red_48dp.width,
             image_sdcard_red_48dp.height,
             image_sdcard_red_48dp.pixel_data);
+        odroid_display_drain_spi();
         odroid_system_halt();
     }
 
@@ -101,7 +160,7 @@ void odroid_system_init(int appId, int sampleRate)
         odroid_settings_StartAction_set(ODROID_START_ACTION_RESUME);
     }
 
-    xTaskCreate(&odroid_system_stats_task, "statistics", 2048, NULL, 7, NULL);
+    xTaskCreate(&odroid_system_stats_task, "statistics", 3072, NULL, 7, NULL);
 
     printf("odroid_system_init: System ready!\n");
 }
@@ -182,14 +241,18 @@ char* odroid_system_get_path(char *_romPath, emu_path_type_t type)
     switch (type)
     {
         case ODROID_PATH_SAVE_STATE:
-        case ODROID_PATH_SAVE_STATE_1:
-        case ODROID_PATH_SAVE_STATE_2:
-        case ODROID_PATH_SAVE_STATE_3:
             strcpy(buffer, ODROID_BASE_PATH_SAVES);
             strcat(buffer, fileName);
             strcat(buffer, ".sav");
             break;
 
+        case ODROID_PATH_SAVE_STATE_1:
+        case ODROID_PATH_SAVE_STATE_2:
+        case ODROID_PATH_SAVE_STATE_3:
+            sprintf(buffer, "%s%s.%d.sav", ODROID_BASE_PATH_SAVES, fileName,
+                type - ODROID_PATH_SAVE_STATE);
+            break;
+
         case ODROID_PATH_SAVE_SRAM:
             strcpy(buffer, ODROID_BASE_PATH_SAVES);
             strcat(buffer, fileName);
@@ -214,6 +277,130 @@ char* odroid_system_get_path(char *_romPath, emu_path_type_t type)
     return buffer;
 }
 
+// The crc cache holds the crc and the header size it was computed past
+uint32_t odroid_system_get_rom_crc32(const char *romPath, const char *exts, size_t skip)
+{
+    char *cachePath = odroid_system_get_path((char*)romPath, ODROID_PATH_CRC_CACHE);
+    const char *ext = odroid_sdcard_get_extension(romPath);
+    uint32_t cache[2] = {0, 0};
+    uint32_t crc = 0;
+    FILE *fp;
+
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+    if ((fp = fopen(cachePath, "rb")))
+    {
+        if (fread(cache, sizeof(cache), 1, fp) == 1 && cache[1] == skip)
+            crc = cache[0];
+        fclose(fp);
+    }
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+    free(cachePath);
+
+    if (crc == 0 && ext && strcasecmp(ext, "zip") == 0)
+    {
+        odroid_zip_t *zip = odroid_sdcard_zip_open(romPath, exts);
+        if (zip)
+        {
+            crc = odroid_sdcard_zip_crc32(zip, skip);
+            odroid_sdcard_zip_close(zip);
+        }
+
+        // Skipping a header means inflating the beginning of the entry
+        if (crc != 0 && skip > 0)
+            odroid_system_set_rom_crc32(romPath, skip, crc);
+    }
+
+    return crc;
+}
+
+void odroid_system_set_rom_crc32(const char *romPath, size_t skip, uint32_t crc)
+{
+    char *cachePath = odroid_system_get_path((char*)romPath, ODROID_PATH_CRC_CACHE);
+    uint32_t cache[2] = {crc, skip};
+    FILE *fp;
+
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+    if ((fp = fopen(cachePath, "wb")))
+    {
+        fwrite(cache, sizeof(cache), 1, fp);
+        fclose(fp);
+    }
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+    free(cachePath);
+}
+
+static void odroid_system_state_writer_task(void *arg)
+{
+    void *job;
+
+    while (1)
+    {
+        xQueuePeek(stateWriter.queue, &job, portMAX_DELAY);
+
+        odroid_input_battery_monitor_enabled_set(0);
+        odroid_system_set_led(1);
+
+        // The sd card lock is only taken for each slice of the write, the
+        // display keeps going while the state is deflated
+        if (stateWriter.compress)
+        {
+            stateWriter.failed = !odroid_sdcard_deflate_memory_to_file(stateWriter.path, stateWriter.buffer, stateWriter.size);
+        }
+        else
+        {
+            stateWriter.failed = !odroid_sdcard_write_memory_to_file(stateWriter.path, stateWriter.buffer, stateWriter.size);
+        }
+
+        odroid_system_set_led(0);
+        odroid_input_battery_monitor_enabled_set(1);
+
+        if (stateWriter.failed)
+        {
+            printf("%s: Writing '%s' failed!\n", __func__, stateWriter.path);
+        }
+
+        free(stateWriter.buffer);
+        free(stateWriter.path);
+
+        xQueueReceive(stateWriter.queue, &job, portMAX_DELAY);
+        stateWriter.pending = false;
+    }
+
+    vTaskDelete(NULL);
+}
+
+void odroid_system_emu_set_state_mem_handler(state_mem_handler_t load, state_mem_handler_t save)
+{
+    loadStateMem = load;
+    saveStateMem = save;
+
+    stateWriter.compress = odroid_settings_CompressSaves_get();
+
+    odroid_system_rewind_enable(odroid_settings_Rewind_get());
+
+    if (save && !stateWriter.queue)
+    {
+        stateWriter.queue = xQueueCreate(1, sizeof(void*));
+        xTaskCreatePinnedToCore(&odroid_system_state_writer_task, "state_writer", 3072, NULL, 1, NULL, 1);
+    }
+}
+
+void odroid_system_emu_flush_state()
+{
+    while (stateWriter.pending)
+    {
+        vTaskDelay(1);
+    }
+
+    if (stateWriter.failed)
+    {
+        stateWriter.failed = false;
+        odroid_overlay_alert("Save failed");
+    }
+}
+
 bool odroid_system_emu_load_state(int slot)
 {
     if (!romPath || !loadState)
@@ -221,14 +408,42 @@ bool odroid_system_emu_load_state(int slot)
 
     printf("odroid_system_emu_load_state: Loading state %d.\n", slot);
 
+    odroid_system_emu_flush_state();
+
     odroid_display_show_hourglass();
     odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
 
-    char *pathName = odroid_system_get_path(NULL, ODROID_PATH_SAVE_STATE);
-    bool success = (*loadState)(pathName);
+    char *pathName = odroid_system_get_path(NULL, ODROID_PATH_SAVE_STATE + slot);
+    size_t size = loadStateMem && saveStateMem ? (*saveStateMem)(NULL, 0) : 0;
+    void *buffer = size ? heap_caps_malloc(size, MEM_SLOW) : NULL;
+    uint32_t magic = 0;
+    FILE *fp;
+
+    if ((fp = fopen(pathName, "rb")))
+    {
+        fread(&magic, sizeof(magic), 1, fp);
+        fclose(fp);
+    }
 
+    // Compressed or not, the whole file is read at once. The memory handler
+    // has no side effects (rewind and netplay use it too), so if it can't take
+    // the file the emulator's own handler deals with it (usually with a reset).
+    size_t len = buffer ? odroid_sdcard_inflate_file_to_memory(pathName, buffer, size) : 0;
     odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
 
+    bool success = len && (*loadStateMem)(buffer, len);
+
+    // The emulators' file handlers can't inflate, they would take the
+    // compressed bytes for a state
+    if (!success && magic != ODROID_SDCARD_DEFLATE_MAGIC)
+    {
+        odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+        success = (*loadState)(pathName);
+        odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+    }
+
+    free(buffer);
+
     if (!success)
     {
         printf("%s: Load failed!\n", __func__);
@@ -239,6 +454,43 @@ bool odroid_system_emu_load_state(int slot)
     return success;
 }
 
+// Same contract as state_mem_handler_t, returns 0 if the emulator has no handler
+size_t odroid_system_emu_save_state_mem(void *buffer, size_t size)
+{
+    return saveStateMem ? (*saveStateMem)(buffer, size) : 0;
+}
+
+size_t odroid_system_emu_load_state_mem(void *buffer, size_t size)
+{
+    return loadStateMem ? (*loadStateMem)(buffer, size) : 0;
+}
+
+static bool odroid_system_emu_save_state_async(char *pathName)
+{
+    size_t size = (*saveStateMem)(NULL, 0);
+    void *buffer = size ? heap_caps_malloc(size, MEM_SLOW) : NULL;
+
+    if (!buffer)
+    {
+        return false;
+    }
+
+    if (!(size = (*saveStateMem)(buffer, size)))
+    {
+        free(buffer);
+        return false;
+    }
+
+    // The game resumes right away, the writer task takes it from here
+    stateWriter.path = pathName;
+    stateWriter.buffer = buffer;
+    stateWriter.size = size;
+    stateWriter.pending = true;
+    xQueueSend(stateWriter.queue, &buffer, portMAX_DELAY);
+
+    return true;
+}
+
 bool odroid_system_emu_save_state(int slot)
 {
     if (!romPath || !saveState)
@@ -246,12 +498,20 @@ bool odroid_system_emu_save_state(int slot)
 
     printf("odroid_system_emu_save_state: Saving state %d.\n", slot);
 
+    odroid_system_emu_flush_state();
+
+    char *pathName = odroid_system_get_path(NULL, ODROID_PATH_SAVE_STATE + slot);
+
+    if (saveStateMem && odroid_system_emu_save_state_async(pathName))
+    {
+        return true;
+    }
+
     odroid_input_battery_monitor_enabled_set(0);
     odroid_system_set_led(1);
     odroid_display_show_hourglass();
     odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
 
-    char *pathName = odroid_system_get_path(NULL, ODROID_PATH_SAVE_STATE);
     bool success = (*saveState)(pathName);
 
     odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
@@ -269,6 +529,324 @@ bool odroid_system_emu_save_state(int slot)
     return success;
 }
 
+static void odroid_system_rewind_free()
+{
+    free(history.state);
+    free(history.capture);
+    free(history.delta);
+    free(history.output);
+    free(history.deflator);
+    free(history.inflator);
+    free(history.ring);
+
+    memset(&history, 0, sizeof(history));
+}
+
+// Done on the first frame, the state size isn't known before the game is loaded
+static bool odroid_system_rewind_alloc()
+{
+    // Rounded up so deltas can be done a word at a time
+    history.size = ((*saveStateMem)(NULL, 0) + 3) & ~3;
+
+    // A delta is stored only if it's smaller than the state, the ring must hold one
+    if (history.size > ODROID_REWIND_BUFFER_SIZE)
+    {
+        printf("%s: State too large for rewind (%d bytes)!\n", __func__, (int)history.size);
+        odroid_system_rewind_free();
+        return false;
+    }
+
+    history.state = heap_caps_malloc(history.size, MEM_SLOW);
+    history.capture = heap_caps_malloc(history.size, MEM_SLOW);
+    history.delta = heap_caps_malloc(history.size, MEM_SLOW);
+    history.output = heap_caps_malloc(history.size, MEM_SLOW);
+    history.deflator = heap_caps_malloc(sizeof(tdefl_compressor), MEM_SLOW);
+    history.inflator = heap_caps_malloc(sizeof(tinfl_decompressor), MEM_SLOW);
+    history.ring = heap_caps_malloc(ODROID_REWIND_BUFFER_SIZE, MEM_SLOW);
+
+    if (!history.size || !history.state || !history.capture || !history.delta || !history.output
+        || !history.deflator || !history.inflator || !history.ring)
+    {
+        printf("%s: Not enough memory for rewind!\n", __func__);
+        odroid_system_rewind_free();
+        return false;
+    }
+
+    history.captured = REWIND_IDLE;
+    history.frames = ODROID_REWIND_INTERVAL;
+    history.enabled = true;
+
+    return true;
+}
+
+bool odroid_system_rewind_enable(bool enable)
+{
+    odroid_system_rewind_free();
+
+    history.enabled = enable && loadStateMem && saveStateMem;
+
+    return history.enabled;
+}
+
+bool odroid_system_rewind_enabled()
+{
+    return history.enabled;
+}
+
+static void odroid_system_rewind_push(const void *data, size_t size)
+{
+    uint32_t offset = history.head;
+
+    if (offset + size > ODROID_REWIND_BUFFER_SIZE)
+    {
+        offset = 0;
+    }
+
+    // Older entries can't be rebuilt without the newer ones, so we always
+    // drop from the oldest end until the new one fits
+    while (history.count > 0)
+    {
+        bool overlap = history.count == ODROID_REWIND_MAX_ENTRIES;
+
+        for (int i = 0; i < history.count && !overlap; i++)
+        {
+            int e = (history.first + i) % ODROID_REWIND_MAX_ENTRIES;
+            overlap = history.entries[e].offset < offset + size
+                && offset < history.entries[e].offset + history.entries[e].size;
+        }
+
+        if (!overlap)
+            break;
+
+        history.stored -= history.entries[history.first].size;
+        history.first = (history.first + 1) % ODROID_REWIND_MAX_ENTRIES;
+        history.count--;
+    }
+
+    int e = (history.first + history.count) % ODROID_REWIND_MAX_ENTRIES;
+    history.entries[e].offset = offset;
+    history.entries[e].size = size;
+    history.count++;
+    history.head = offset + size;
+    history.stored += size;
+
+    memcpy(history.ring + offset, data, size);
+}
+
+static bool odroid_system_rewind_pop()
+{
+    if (history.count == 0)
+    {
+        return false;
+    }
+
+    int e = (history.first + history.count - 1) % ODROID_REWIND_MAX_ENTRIES;
+    size_t in_size = history.entries[e].size;
+    size_t out_size = history.size;
+
+    tinfl_init(history.inflator);
+    tinfl_status status = tinfl_decompress(history.inflator, history.ring + history.entries[e].offset,
+        &in_size, history.delta, history.delta, &out_size, TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+
+    if (status != TINFL_STATUS_DONE || out_size != history.size)
+    {
+        printf("%s: Corrupted snapshot, history dropped.\n", __func__);
+        history.count = history.stored = 0;
+        return false;
+    }
+
+    uint32_t *state = (uint32_t *)history.state;
+    uint32_t *delta = (uint32_t *)history.delta;
+
+    for (int i = 0; i < history.size / 4; i++)
+    {
+        state[i] ^= delta[i];
+    }
+
+    history.head = history.entries[e].offset;
+    history.stored -= history.entries[e].size;
+    history.count--;
+
+    return true;
+}
+
+// Snapshot every few frames, then deflate the delta a chunk at a time until
+// the frame's budget is spent. Capture resumes only once it's stored.
+static void odroid_system_rewind_capture()
+{
+    uint startTime = get_elapsed_time();
+
+    history.stats.frames++;
+
+    if (history.captured == REWIND_IDLE)
+    {
+        if (--history.frames > 0)
+            return;
+
+        size_t len = (*saveStateMem)(history.capture, history.size);
+        if (len == 0 || len > history.size)
+            return;
+
+        memset(history.capture + len, 0, history.size - len);
+        history.frames = ODROID_REWIND_INTERVAL;
+
+        // The first one has nothing to be a delta of
+        if (!history.valid)
+        {
+            memcpy(history.state, history.capture, history.size);
+            history.valid = true;
+            return;
+        }
+
+        tdefl_init(history.deflator, NULL, NULL, REWIND_DEFLATE_FLAGS);
+        history.outputUsed = 0;
+        history.captured = 0;
+    }
+
+    do
+    {
+        size_t chunk = MIN(REWIND_CHUNK, history.size - history.captured);
+        uint32_t *capture = (uint32_t *)(history.capture + history.captured);
+        uint32_t *state = (uint32_t *)(history.state + history.captured);
+        uint32_t *delta = (uint32_t *)history.delta;
+
+        for (int i = 0; i < chunk / 4; i++)
+        {
+            delta[i] = capture[i] ^ state[i];
+        }
+
+        bool last = history.captured + chunk == history.size;
+        uint8_t *input = history.delta;
+        size_t input_left = chunk;
+        tdefl_status status;
+
+        do
+        {
+            size_t in_size = input_left;
+            size_t out_size = history.size - history.outputUsed;
+
+            status = tdefl_compress(history.deflator, input, &in_size, history.output + history.outputUsed,
+                &out_size, last ? TDEFL_FINISH : TDEFL_NO_FLUSH);
+
+            history.outputUsed += out_size;
+            input += in_size;
+            input_left -= in_size;
+
+            if (in_size == 0 && out_size == 0)
+                break;
+        }
+        while (status == TDEFL_STATUS_OKAY && (input_left > 0 || last));
+
+        // A delta that doesn't shrink isn't worth keeping, the next one will
+        // simply span two intervals
+        if (input_left > 0 || (last && status != TDEFL_STATUS_DONE) || status < 0)
+        {
+            history.captured = REWIND_IDLE;
+            break;
+        }
+
+        history.captured += chunk;
+
+        if (last)
+        {
+            uint8_t *newest = history.capture;
+            history.capture = history.state;
+            history.state = newest;
+            history.captured = REWIND_IDLE;
+
+            odroid_system_rewind_push(history.output, history.outputUsed);
+
+            history.stats.snapshots++;
+            history.stats.bytesOut += history.outputUsed;
+            break;
+        }
+    }
+    while (get_elapsed_time_since(startTime) < ODROID_REWIND_FRAME_BUDGET);
+
+    uint elapsed = get_elapsed_time_since(startTime);
+    history.stats.time += elapsed;
+    history.stats.maxTime = MAX(history.stats.maxTime, elapsed);
+}
+
+bool odroid_system_rewind_tick(odroid_gamepad_state *joystick)
+{
+    if (!history.enabled || odroid_netplay_mode() != NETPLAY_MODE_NONE)
+    {
+        return false;
+    }
+
+    if (!history.state && !odroid_system_rewind_alloc())
+    {
+        return false;
+    }
+
+    bool rewind = joystick->values[ODROID_REWIND_KEY_MOD] && joystick->values[ODROID_REWIND_KEY];
+
+    // The modifier is a game button too. It's held back while down and only
+    // reaches the game as a short press on release, unless it was used to rewind.
+    if (joystick->values[ODROID_REWIND_KEY_MOD])
+    {
+        history.modifierHeld = true;
+        history.modifierUsed |= rewind;
+        joystick->values[ODROID_REWIND_KEY_MOD] = 0;
+    }
+    else if (history.modifierHeld)
+    {
+        if (!history.modifierUsed)
+            history.modifierTap = REWIND_TAP_FRAMES;
+        history.modifierHeld = false;
+        history.modifierUsed = false;
+    }
+
+    if (history.modifierTap > 0)
+    {
+        joystick->values[ODROID_REWIND_KEY_MOD] = 1;
+        history.modifierTap--;
+    }
+
+    if (!history.valid)
+    {
+        odroid_system_rewind_capture();
+        return false;
+    }
+
+    if (!rewind)
+    {
+        if (history.rewinding)
+        {
+            history.rewinding = false;
+            history.frames = ODROID_REWIND_INTERVAL;
+            odroid_audio_mute(false);
+        }
+
+        odroid_system_rewind_capture();
+        return false;
+    }
+
+    if (!history.rewinding)
+    {
+        // Whatever was being compressed is newer than where we're going
+        history.rewinding = true;
+        history.captured = REWIND_IDLE;
+        history.frames = 0;
+        odroid_audio_mute(true);
+    }
+
+    // Hold each snapshot for a few frames, the emulator runs the same frame
+    // again every time so the picture stays put
+    if (--history.frames <= 0)
+    {
+        odroid_system_rewind_pop();
+        history.frames = ODROID_REWIND_STEP_FRAMES;
+    }
+
+    (*loadStateMem)(history.state, history.size);
+
+    memset(joystick->values, 0, sizeof(joystick->values));
+
+    return true;
+}
+
 void odroid_system_reload_app()
 {
     //
@@ -278,8 +856,13 @@ void odroid_system_switch_app(int app)
 {
     printf("odroid_system_switch_app: Switching to app %d.\n", app);
 
+    // Don't cut a save state in half
+    odroid_system_emu_flush_state();
+    odroid_settings_commit();
+
     odroid_display_clear(0);
     odroid_display_show_hourglass();
+    odroid_display_drain_spi();
 
     odroid_audio_terminate();
     odroid_sdcard_close();
@@ -339,6 +922,7 @@ void odroid_system_sleep()
 
     // Wait for button release
     odroid_input_wait_for_key(ODROID_INPUT_MENU, false);
+    odroid_settings_commit();
     odroid_audio_terminate();
     vTaskDelay(100);
     esp_deep_sleep_start();
@@ -367,6 +951,50 @@ static void odroid_system_stats_task(void *arg)
             frameCounter.full,
             battery.millivolts);
 
+        if (history.enabled && history.stats.frames > 0)
+        {
+            printf("REWIND: %d snapshots (%dKB), DELTA:%dB, TIME:%dus avg %dus max\n",
+                history.count,
+                history.stored / 1024,
+                history.stats.snapshots ? history.stats.bytesOut / history.stats.snapshots : 0,
+                history.stats.time / history.stats.frames,
+                history.stats.maxTime);
+
+            memset(&history.stats, 0, sizeof(history.stats));
+        }
+
+        odroid_sdcard_stats_t sdStats = odroid_sdcard_get_stats(true);
+        if (sdStats.reads + sdStats.writes + sdStats.seeks > 0)
+        {
+            printf("SDCARD: %d reads (%dKB), %d writes (%dKB), %d seeks\n",
+                sdStats.reads,
+                sdStats.bytesRead / 1024,
+                sdStats.writes,
+                sdStats.bytesWritten / 1024,
+                sdStats.seeks);
+        }
+
+        netplay_stats_t netStats = odroid_netplay_get_stats(true);
+        if (netStats.frames > 0)
+        {
+            printf("NETPLAY: STALL:%d frames %dus avg %dus max, PACKETS:%d sent %d received %d lost, RESENT:%d, ROLLBACK:%d (%d frames), DESYNC:%d\n",
+                netStats.stalls,
+                netStats.stall_time / netStats.frames,
+                netStats.max_stall,
+                netStats.packets_sent,
+                netStats.packets_received,
+                netStats.packets_lost,
+                netStats.resent,
+                netStats.rollbacks,
+                netStats.resimulated,
+                netStats.desyncs);
+            printf("NETPLAY: STALLS <1ms:%d <2ms:%d <4ms:%d <8ms:%d <16ms:%d <32ms:%d <64ms:%d >=64ms:%d\n",
+                netStats.stall_hist[0], netStats.stall_hist[1], netStats.stall_hist[2], netStats.stall_hist[3],
+                netStats.stall_hist[4], netStats.stall_hist[5], netStats.stall_hist[6], netStats.stall_hist[7]);
+        }
+
+        odroid_settings_commit_pending();
+
         frameCounter.total = frameCounter.skipped = frameCounter.full = 0;
         frameCounter.resetTime = get_elapsed_time();
 
@@ -385,13 +1013,19 @@ void IRAM_ATTR odroid_system_stats_tick(bool frameSkipped, bool fullFrame)
 
 void IRAM_ATTR odroid_system_spi_lock_acquire(spi_lock_res_t owner)
 {
-    if (owner == spiMutexOwner)
+    // Display transactions are released by the spi task, but sd card users
+    // can now be background tasks and must only nest within the same task
+    if (owner == spiMutexOwner && (owner != SPI_LOCK_SDCARD || spiMutexTask == xTaskGetCurrentTaskHandle()))
     {
+        if (owner == SPI_LOCK_SDCARD)
+            spiMutexDepth++;
         return;
     }
     else if (xSemaphoreTake(spiMutex, 10000 / portTICK_RATE_MS) == pdPASS)
     {
         spiMutexOwner = owner;
+        spiMutexTask = xTaskGetCurrentTaskHandle();
+        spiMutexDepth = 1;
     }
     else
     {
@@ -402,10 +1036,19 @@ void IRAM_ATTR odroid_system_spi_lock_acquire(spi_lock_res_t owner)
 
 void IRAM_ATTR odroid_system_spi_lock_release(spi_lock_res_t owner)
 {
+    // An sd card user nested in another one (sram_load inside a state load)
+    // must not hand the bus to the background tasks while the outer one works.
+    // The display count isn't balanced, the spi task releases it once idle.
+    if (owner == SPI_LOCK_SDCARD && owner == spiMutexOwner && --spiMutexDepth > 0)
+    {
+        return;
+    }
+
     if (owner == spiMutexOwner || owner == SPI_LOCK_ANY)
     {
-        xSemaphoreGive(spiMutex);
+        spiMutexDepth = 0;
         spiMutexOwner = SPI_LOCK_ANY;
+        xSemaphoreGive(spiMutex);
     }
 }
 
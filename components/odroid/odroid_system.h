@@ -15,6 +15,10 @@
 extern int8_t speedupEnabled;
 
 typedef bool (*state_handler_t)(char *pathName);
+// Serialize the emulator into buffer and return the number of bytes used (0 on
+// failure). With a NULL buffer it returns the size needed instead. The load
+// handler restores from buffer and returns 0 on failure.
+typedef size_t (*state_mem_handler_t)(void *buffer, size_t size);
 
 typedef struct
 {
@@ -29,6 +33,23 @@ typedef struct
 #define ODROID_BASE_PATH_SAVES     SD_BASE_PATH "/odroid/data"
 #define ODROID_BASE_PATH_ROMART    SD_BASE_PATH "/romart"
 #define ODROID_BASE_PATH_CRC_CACHE SD_BASE_PATH "/odroid/cache/crc"
+#define ODROID_BASE_PATH_ROM_INDEX SD_BASE_PATH "/odroid/cache/index"
+#define ODROID_BASE_PATH_COVER_CACHE SD_BASE_PATH "/odroid/cache/covers"
+
+#define ODROID_SAVE_STATE_SLOTS 4
+
+// Rewind history, in PSRAM. Snapshots are taken every ODROID_REWIND_INTERVAL
+// frames and compressing them never takes more than ODROID_REWIND_FRAME_BUDGET
+// microseconds of any frame. Holding SELECT + LEFT steps back one snapshot
+// every ODROID_REWIND_STEP_FRAMES frames. While rewind is on, games only see
+// SELECT as a short press when it's released without having rewound.
+#define ODROID_REWIND_BUFFER_SIZE  (512 * 1024)
+#define ODROID_REWIND_MAX_ENTRIES  256
+#define ODROID_REWIND_INTERVAL     10
+#define ODROID_REWIND_FRAME_BUDGET 1000
+#define ODROID_REWIND_STEP_FRAMES  3
+#define ODROID_REWIND_KEY_MOD      ODROID_INPUT_SELECT
+#define ODROID_REWIND_KEY          ODROID_INPUT_LEFT
 
 typedef enum
 {
@@ -50,8 +71,15 @@ typedef enum
 } spi_lock_res_t;
 
 void odroid_system_emu_init(state_handler_t load, state_handler_t save, netplay_callback_t netplay_cb);
+void odroid_system_emu_set_state_mem_handler(state_mem_handler_t load, state_mem_handler_t save);
 bool odroid_system_emu_save_state(int slot);
 bool odroid_system_emu_load_state(int slot);
+void odroid_system_emu_flush_state();
+size_t odroid_system_emu_save_state_mem(void *buffer, size_t size);
+size_t odroid_system_emu_load_state_mem(void *buffer, size_t size);
+bool odroid_system_rewind_enable(bool enable);
+bool odroid_system_rewind_enabled();
+bool odroid_system_rewind_tick(odroid_gamepad_state *joystick);
 void odroid_system_init(int app_id, int sampleRate);
 uint odroid_system_get_app_id();
 void odroid_system_set_app_id(int appId);
@@ -67,6 +95,12 @@ void odroid_system_set_boot_app(int slot);
 void odroid_system_set_led(int value);
 void odroid_system_stats_tick(bool frameSkipped, bool fullFrame);
 char* odroid_system_get_path(char *romPath, emu_path_type_t type);
+// Identifies a rom by the crc32 of its data past the first skip bytes (a
+// header). Known crcs come from the crc cache or, for zip archives, from the
+// central directory. 0 means the data has to be read, the result can then be
+// cached with odroid_system_set_rom_crc32.
+uint32_t odroid_system_get_rom_crc32(const char *romPath, const char *exts, size_t skip);
+void odroid_system_set_rom_crc32(const char *romPath, size_t skip, uint32_t crc);
 
 void odroid_system_spi_lock_acquire(spi_lock_res_t);
 void odroid_system_spi_lock_release(spi_lock_res_t);
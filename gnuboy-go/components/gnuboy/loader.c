@@ -12,8 +12,12 @@
 #include "rtc.h"
 #include "sound.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_heap_caps.h"
 #include "odroid_system.h"
+#include "odroid_sdcard.h"
 
 static const byte mbc_table[256] =
 {
@@ -76,6 +80,12 @@ static const byte ramsize_table[256] =
 
 
 static FILE* fpRomFile = NULL;
+static odroid_zip_t* zipRomFile = NULL;
+static bool zipRom = false;
+
+/* Free memory left alone when keeping the banks inflated on the way to the
+   one requested from a zipped rom */
+#define ZIP_ROM_RESERVE (256 * 1024)
 
 static char *romfile=NULL;
 static char *sramfile=NULL;
@@ -87,6 +97,29 @@ static int forcedmg=0, gbamode=0;
 
 static int memfill = 0, memrand = -1;
 
+/* Write the battery save to a temporary file then rename it, instead of
+   rewriting the modified banks in place */
+int sram_atomic = 0;
+
+/* Deflate the whole battery save on every write, sram_load reads both */
+int sram_compress = 0;
+
+/* Room for the rtc after the sram banks, padded so that it can be
+   rewritten in place */
+#define SRAM_RTC_SIZE 64
+
+/* The banks to flush are copied here by the emulation thread then
+   written to the card by sram_task, lock protects all of it. The rtc
+   follows the banks so the file image is contiguous */
+static struct
+{
+	byte (*sbank)[8192];
+	byte *rtc;
+	un32 banks;
+	SemaphoreHandle_t lock;
+	TaskHandle_t task;
+} sram_flush;
+
 
 static inline void initmem(void *mem, int size)
 {
@@ -110,6 +143,52 @@ static byte *loadfile(FILE *f, int *len)
 }
 
 
+/* Zipped roms can only be inflated sequentially, so the banks found on the
+   way to the one requested are kept as well. The archive is closed once the
+   end is reached and only reopened if a bank gets reclaimed */
+static void rom_loadbank_zip(short bank)
+{
+	const size_t BANK_SIZE = 0x4000;
+	const size_t OFFSET = bank * BANK_SIZE;
+
+	if (!zipRomFile && !(zipRomFile = odroid_sdcard_zip_open(romfile, "gb,gbc")))
+	{
+		odroid_system_panic("ROM zip open failed");
+	}
+
+	size_t pos = odroid_sdcard_zip_tell(zipRomFile);
+
+	for (short i = (pos > OFFSET ? 0 : pos / BANK_SIZE); i < bank; i++)
+	{
+		if (rom.bank[i])
+			continue;
+
+		if (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) < ZIP_ROM_RESERVE
+			|| !(rom.bank[i] = heap_caps_malloc(BANK_SIZE, MALLOC_CAP_SPIRAM)))
+			break;
+
+		if (odroid_sdcard_zip_read(zipRomFile, i * BANK_SIZE, rom.bank[i], BANK_SIZE) < BANK_SIZE)
+		{
+			free(rom.bank[i]);
+			rom.bank[i] = NULL;
+			break;
+		}
+	}
+
+	if (odroid_sdcard_zip_read(zipRomFile, OFFSET, rom.bank[bank], BANK_SIZE) < BANK_SIZE)
+	{
+		printf("bank_load: zip read failed. bank=%d\n", bank);
+		odroid_system_panic("ROM zip read failed");
+	}
+
+	if (odroid_sdcard_zip_tell(zipRomFile) >= odroid_sdcard_zip_size(zipRomFile))
+	{
+		odroid_sdcard_zip_close(zipRomFile);
+		zipRomFile = NULL;
+	}
+}
+
+
 int IRAM_ATTR rom_loadbank(short bank)
 {
 	const size_t BANK_SIZE = 0x4000;
@@ -133,6 +212,11 @@ int IRAM_ATTR rom_loadbank(short bank)
 		odroid_system_panic("Out of memory");
 	}
 
+	if (zipRom) {
+		rom_loadbank_zip(bank);
+		return 0;
+	}
+
 	// Make sure no transaction is running
 	odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
 
@@ -159,8 +243,9 @@ int rom_load()
 {
     printf("loader: Loading file: %s\n", romfile);
 
-	fpRomFile = fopen(romfile, "rb");
-	if (fpRomFile == NULL)
+	zipRom = strcasecmp(romfile + strlen(romfile) - 4, ".zip") == 0;
+
+	if (!zipRom && (fpRomFile = odroid_sdcard_fopen(romfile, "rb")) == NULL)
 	{
 		printf("loader: fopen failed.\n");
 		odroid_system_panic("ROM fopen failed");
@@ -240,55 +325,242 @@ int rom_load()
 
 int sram_load()
 {
+	const int size = 8192 * mbc.ramsize;
 	int ret = -1;
 	FILE *f;
 
 	if (!mbc.batt || !sramfile || !*sramfile) return -1;
 
+	byte *buf = malloc(size + SRAM_RTC_SIZE);
+	if (!buf) return -1;
+
 	odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
 
-	if ((f = fopen(sramfile, "rb")))
+	// Reads plain and deflated files alike
+	size_t len = odroid_sdcard_inflate_file_to_memory(sramfile, buf, size + SRAM_RTC_SIZE);
+
+	if (len == 0)
+	{
+		// An atomic write was cut between the unlink and the rename, the
+		// complete save is still in the temporary file
+		char tmpfile[strlen(sramfile) + 5];
+		sprintf(tmpfile, "%s.tmp", sramfile);
+		len = odroid_sdcard_inflate_file_to_memory(tmpfile, buf, size + SRAM_RTC_SIZE);
+		if (len > 0)
+			printf("sram_load: Recovered SRAM from %s\n", tmpfile);
+	}
+
+	odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+	if (len > 0)
 	{
 		printf("sram_load: Loading SRAM\n");
-		fread(ram.sbank, 8192, mbc.ramsize, f);
-		rtc_load_internal(f); // Temporary hack, hopefully
-		fclose(f);
+		memcpy(ram.sbank, buf, len < size ? len : size);
+		if (len > size && (f = fmemopen(buf + size, len - size, "rb")))
+		{
+			rtc_load_internal(f); // Temporary hack, hopefully
+			fclose(f);
+		}
 		ret = 0;
 	}
 
-	odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+	free(buf);
+
+	if (ret == 0)
+	{
+		// The file matches the sram again, keep the staging copy in sync
+		if (sram_flush.sbank)
+		{
+			xSemaphoreTake(sram_flush.lock, portMAX_DELAY);
+			memcpy(sram_flush.sbank, ram.sbank, 8192 * mbc.ramsize);
+			sram_flush.banks = 0;
+			xSemaphoreGive(sram_flush.lock);
+		}
+		ram.sram_dirty_banks = 0;
+	}
+
 	return ret;
 }
 
 
-int sram_save()
+static int sram_snapshot()
 {
-	int ret = -1;
-	FILE *f;
+	un32 banks = ram.sram_dirty_banks;
 
-	if (!mbc.batt || !sramfile || !mbc.ramsize) return -1;
+	if (!sram_flush.sbank)
+	{
+		sram_flush.sbank = rg_alloc(8192 * mbc.ramsize + SRAM_RTC_SIZE, MEM_ANY);
+		if (!sram_flush.sbank)
+			return -1;
+		sram_flush.rtc = (byte *)sram_flush.sbank[mbc.ramsize];
+		banks = ~0;
+	}
+
+	for (int i = 0; i < mbc.ramsize; i++)
+	{
+		if (banks & (1 << i))
+			memcpy(sram_flush.sbank[i], ram.sbank[i], 8192);
+	}
+
+	sram_flush.banks |= banks;
+	ram.sram_dirty_banks = 0;
+
+	// Pad with whitespace, rtc_load_internal will skip it
+	memset(sram_flush.rtc, ' ', SRAM_RTC_SIZE);
+	FILE *f = fmemopen(sram_flush.rtc, SRAM_RTC_SIZE, "wb");
+	rtc_save_internal(f);
+	long len = ftell(f);
+	fclose(f);
+	if (len < SRAM_RTC_SIZE)
+		memset(sram_flush.rtc + len, ' ', SRAM_RTC_SIZE - len);
+
+	return 0;
+}
+
+
+static int sram_write()
+{
+	const int size = 8192 * mbc.ramsize;
+	char tmpfile[strlen(sramfile) + 5];
+	char *path = sramfile;
+	bool in_place = false;
+	int ret = -1;
+	FILE *f = NULL;
 
 	odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
 
-	if ((f = fopen(sramfile, "wb")))
+	if (!sram_atomic && !sram_compress && (f = odroid_sdcard_fopen(sramfile, "r+b")))
 	{
-		printf("sram_load: Saving SRAM\n");
-		fwrite(ram.sbank, 8192, mbc.ramsize, f);
-		rtc_save_internal(f); // Temporary hack, hopefully
-		fclose(f);
-		ret = 0;
+		// Only rewrite the banks in place if the file is complete and not deflated
+		uint32_t magic = 0;
+		fread(&magic, sizeof(magic), 1, f);
+		fseek(f, 0, SEEK_END);
+		in_place = ftell(f) >= size && magic != ODROID_SDCARD_DEFLATE_MAGIC;
+	}
+
+	if (in_place)
+	{
+		printf("sram_save: Updating SRAM banks 0x%04X\n", sram_flush.banks);
+		for (int i = 0; i < mbc.ramsize; i++)
+		{
+			if (!(sram_flush.banks & (1 << i)))
+				continue;
+			fseek(f, 8192 * i, SEEK_SET);
+			fwrite(sram_flush.sbank[i], 8192, 1, f);
+		}
+		fseek(f, size, SEEK_SET);
+		if (fwrite(sram_flush.rtc, SRAM_RTC_SIZE, 1, f) == 1)
+			ret = 0;
 	}
 
+	if (f)
+		fclose(f);
+
 	odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+	if (!in_place)
+	{
+		if (sram_atomic)
+		{
+			sprintf(tmpfile, "%s.tmp", sramfile);
+			path = tmpfile;
+		}
+
+		// The rtc follows the banks in the staging buffer. The sd card lock
+		// is only taken for each slice of the write, not while deflating.
+		if (sram_compress)
+		{
+			printf("sram_save: Saving compressed SRAM\n");
+			if (odroid_sdcard_deflate_memory_to_file(path, sram_flush.sbank, size + SRAM_RTC_SIZE) > 0)
+				ret = 0;
+		}
+		else
+		{
+			printf("sram_save: Saving SRAM\n");
+			if (odroid_sdcard_write_memory_to_file(path, sram_flush.sbank, size + SRAM_RTC_SIZE) > 0)
+				ret = 0;
+		}
+	}
+
+	if (ret == 0)
+		sram_flush.banks = 0;
+
+	if (ret == 0 && path != sramfile)
+	{
+		// FAT can't rename over an existing file
+		odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+		unlink(sramfile);
+		ret = rename(path, sramfile);
+		odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+	}
+
+	return ret;
+}
+
+
+static void sram_task(void *arg)
+{
+	while (1)
+	{
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		xSemaphoreTake(sram_flush.lock, portMAX_DELAY);
+		if (sram_write() != 0)
+			printf("sram_task: Saving SRAM failed!\n");
+		xSemaphoreGive(sram_flush.lock);
+	}
+}
+
+
+int sram_save()
+{
+	int ret;
+
+	if (!mbc.batt || !sramfile || !mbc.ramsize) return -1;
+
+	if (!sram_flush.lock)
+		sram_flush.lock = xSemaphoreCreateMutex();
+
+	xSemaphoreTake(sram_flush.lock, portMAX_DELAY);
+	ret = sram_snapshot() == 0 ? sram_write() : -1;
+	xSemaphoreGive(sram_flush.lock);
+
 	return ret;
 }
 
 
+/* Same as sram_save but the card is written by a low priority task. Returns
+   1 without blocking if the previous flush is still in progress. */
+int sram_save_async()
+{
+	if (!mbc.batt || !sramfile || !mbc.ramsize) return -1;
+
+	if (!sram_flush.lock)
+		sram_flush.lock = xSemaphoreCreateMutex();
+
+	if (!sram_flush.task)
+		xTaskCreatePinnedToCore(&sram_task, "sram_task", 3072, NULL, 1, &sram_flush.task, 1);
+
+	if (xSemaphoreTake(sram_flush.lock, 0) != pdTRUE)
+		return 1;
+
+	if (sram_snapshot() != 0)
+	{
+		xSemaphoreGive(sram_flush.lock);
+		return -1;
+	}
+	xSemaphoreGive(sram_flush.lock);
+	xTaskNotifyGive(sram_flush.task);
+
+	return 0;
+}
+
+
 int state_save(char *name)
 {
 	FILE *f;
 
-	if ((f = fopen(name, "wb")))
+	if ((f = odroid_sdcard_fopen(name, "wb")))
 	{
 		savestate(f);
 		rtc_save_internal(f);
@@ -304,7 +576,59 @@ int state_load(char *name)
 {
 	FILE *f;
 
-	if ((f = fopen(name, "rb")))
+	if ((f = odroid_sdcard_fopen(name, "rb")))
+	{
+		loadstate(f);
+		rtc_load_internal(f);
+		fclose(f);
+		vram_dirty();
+		pal_dirty();
+		sound_dirty();
+		mem_updatemap();
+		return 0;
+	}
+
+	return -1;
+}
+
+/* Header, iram, vram, sram blocks, plus room for the rtc line */
+int state_size()
+{
+	int irl = hw.cgb ? 8 : 2;
+	int vrl = hw.cgb ? 4 : 2;
+	int srl = mbc.ramsize << 1;
+
+	return ((1 + irl + vrl + srl) << 12) + 128;
+}
+
+
+/* Same format as state_save, returns the number of bytes used */
+int state_save_mem(void *buffer, int size)
+{
+	FILE *f;
+	int len = -1;
+
+	if (size < state_size())
+		return -1;
+
+	if ((f = fmemopen(buffer, size, "wb")))
+	{
+		savestate(f);
+		rtc_save_internal(f);
+		fflush(f);
+		len = ftell(f);
+		fclose(f);
+	}
+
+	return len;
+}
+
+
+int state_load_mem(const void *buffer, int size)
+{
+	FILE *f;
+
+	if ((f = fmemopen((void *)buffer, size, "rb")))
 	{
 		loadstate(f);
 		rtc_load_internal(f);
@@ -341,10 +665,12 @@ void rtc_load()
 void loader_unload()
 {
 	sram_save();
+	if (zipRomFile) odroid_sdcard_zip_close(zipRomFile);
 	if (romfile) free(romfile);
 	if (sramfile) free(sramfile);
 	if (saveprefix) free(saveprefix);
 	if (ram.sbank) free(ram.sbank);
+	if (sram_flush.sbank) free(sram_flush.sbank);
 
 	for (int i = 0; i < 512; i++) {
 		if (rom.bank[i]) {
@@ -355,6 +681,11 @@ void loader_unload()
 
 	mbc.type = mbc.romsize = mbc.ramsize = mbc.batt = 0;
 	ram.sbank = romfile = sramfile = saveprefix = 0;
+	zipRomFile = NULL;
+	zipRom = false;
+	sram_flush.sbank = NULL;
+	sram_flush.rtc = NULL;
+	sram_flush.banks = 0;
 }
 
 void loader_init(char *s)
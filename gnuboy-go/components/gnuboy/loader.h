@@ -12,6 +12,8 @@ typedef struct loader_s
 
 
 extern loader_t loader;
+extern int sram_atomic;
+extern int sram_compress;
 
 void loader_init(char *s);
 void loader_unload();
@@ -19,8 +21,12 @@ int rom_loadbank(short);
 int rom_load();
 int sram_load();
 int sram_save();
+int sram_save_async();
 int state_load(char *s);
 int state_save(char *s);
+int state_size();
+int state_load_mem(const void *buffer, int size);
+int state_save_mem(void *buffer, int size);
 
 
 #endif
@@ -448,6 +448,7 @@ void IRAM_ATTR mem_write(word a, byte b)
 		} else {
 			ram.sbank[mbc.rambank][a & 0x1FFF] = b;
 			ram.sram_dirty = 1;
+			ram.sram_dirty_banks |= 1 << mbc.rambank;
 		}
 		break;
 
@@ -39,6 +39,7 @@ struct ram
 	byte ibank[8][4096];
 	byte (*sbank)[8192];
 	byte sram_dirty;
+	un32 sram_dirty_banks; /* banks modified since the last sram flush */
 };
 
 
@@ -228,7 +228,11 @@ void loadstate(FILE *f)
 	__asm__("nop");
 	__asm__("memw");
 
-	printf("loadstate: read sram addr=%p, size=0x%x, count=%d\n", (void*)ram.sbank, 4096 * srl, count);
+	if (count != srl)
+		printf("loadstate: short sram read, count=%d\n", count);
+
+	// The battery save no longer matches any of the banks
+	ram.sram_dirty_banks = ~0;
 
 	//byte* ptr = (byte*)(0x3f800000 + 0x300000 + (0xbe7a & 0x1fff));
 	//printf("loadstate: watch = 0x%x, 0x%x, 0x%x, 0x%x\n", *ptr, *(ptr+1), *(ptr+2), *(ptr+3));
@@ -308,14 +312,13 @@ void savestate(FILE *f)
 		__asm__("nop");
 		__asm__("nop");
 		__asm__("memw");
-		size_t count = fwrite(buf, 4096, 1, f);
+		fwrite(buf, 4096, 1, f);
 		__asm__("nop");
 		__asm__("nop");
 		__asm__("nop");
 		__asm__("nop");
 		__asm__("memw");
 
-		printf("savesate: wrote sram addr=%p, size=0x%x, count=%d\n", (void*)tmp, 4096, count);
 		tmp += 4096;
 	}
 
@@ -27,6 +27,7 @@
 #define GB_HEIGHT (144)
 
 #define NVS_KEY_SAVE_SRAM "sram"
+#define NVS_KEY_SRAM_ATOMIC "sramAtomic"
 
 struct fb fb;
 struct pcm pcm;
@@ -127,6 +128,20 @@ static bool SaveState(char *pathName)
     return state_save(pathName) == 0;
 }
 
+static size_t SaveStateMem(void *buffer, size_t size)
+{
+    if (buffer == NULL)
+        return state_size();
+
+    int len = state_save_mem(buffer, size);
+    return len > 0 ? len : 0;
+}
+
+static size_t LoadStateMem(void *buffer, size_t size)
+{
+    return state_load_mem(buffer, size) == 0 ? size : 0;
+}
+
 static bool LoadState(char *pathName)
 {
     if (state_load(pathName) != 0)
@@ -178,6 +193,18 @@ static bool save_sram_update_cb(odroid_dialog_choice_t *option, odroid_dialog_ev
     return event == ODROID_DIALOG_ENTER;
 }
 
+static bool sram_atomic_update_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t event)
+{
+    if (event == ODROID_DIALOG_PREV || event == ODROID_DIALOG_NEXT) {
+        sram_atomic = !sram_atomic;
+        odroid_settings_app_int32_set(NVS_KEY_SRAM_ATOMIC, sram_atomic);
+    }
+
+    strcpy(option->value, sram_atomic ? "Safe" : "Fast");
+
+    return event == ODROID_DIALOG_ENTER;
+}
+
 static bool rtc_t_update_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t event)
 {
     if (option->id == 'd') {
@@ -225,6 +252,7 @@ static bool advanced_settings_cb(odroid_dialog_choice_t *option, odroid_dialog_e
       odroid_dialog_choice_t options[] = {
         {101, "Set clock", "00:00", 1, &rtc_update_cb},
         {102, "Save SRAM", "No", 1, &save_sram_update_cb},
+        {103, "SRAM write", "Fast", 1, &sram_atomic_update_cb},
         ODROID_DIALOG_CHOICE_LAST
       };
       odroid_overlay_dialog("Advanced", options, 0);
@@ -239,12 +267,15 @@ void app_main(void)
     // Init all the console hardware
     odroid_system_init(APP_ID, AUDIO_SAMPLE_RATE);
     odroid_system_emu_init(&LoadState, &SaveState, &netplay_callback);
+    odroid_system_emu_set_state_mem_handler(&LoadStateMem, &SaveStateMem);
 
     update1.buffer = rg_alloc(GB_WIDTH * GB_HEIGHT * 2, MEM_ANY);
     update2.buffer = rg_alloc(GB_WIDTH * GB_HEIGHT * 2, MEM_ANY);
     audioBuffer    = rg_alloc(AUDIO_BUFFER_LENGTH * 2 * 2, MEM_DMA);
 
     saveSRAM = odroid_settings_app_int32_get(NVS_KEY_SAVE_SRAM, 0);
+    sram_atomic = odroid_settings_app_int32_get(NVS_KEY_SRAM_ATOMIC, 0);
+    sram_compress = odroid_settings_CompressSaves_get();
 
     // Load ROM
     char *romPath = odroid_system_get_path(NULL, ODROID_PATH_ROM_FILE);
@@ -307,6 +338,8 @@ void app_main(void)
             odroid_overlay_game_settings_menu(options);
         }
 
+        odroid_system_rewind_tick(&joystick);
+
         uint startTime = get_elapsed_time();
         bool drawFrame = !skipFrames;
 
@@ -331,8 +364,10 @@ void app_main(void)
 
             if (sramSaveTimer > 0 && --sramSaveTimer == 0)
             {
-                // TO DO: Try compressing the sram file, it might reduce stuttering
-                sram_save();
+                // The card is written in the background, retry next frame if
+                // the previous flush isn't done yet
+                if (sram_save_async() == 1)
+                    sramSaveTimer = 1;
             }
         }
 
@@ -11,7 +11,8 @@
 #define TRACE(x...)
 #endif
 
-static gfx_context saved_gfx_context[4];
+//! Registers in effect for the pending lines, consumed by render_lines
+static gfx_context latched_context;
 
 //! Whether we need to draw pending lines
 static bool gfx_need_redraw = 0;
@@ -90,10 +91,17 @@ gfx_init()
     gfx_need_redraw = 0;
     UCount = 0;
 
-	// Sprite memory
-	VRAMS = VRAMS ?: (uchar *)rg_alloc(VRAMSIZE, MEM_FAST);
-	VRAM2 = VRAM2 ?: (uchar *)rg_alloc(VRAMSIZE, MEM_FAST);
-    memset(&SPR_CACHE, 0, sizeof(SPR_CACHE));
+	// Sprite memory, in internal ram unless it would leave too little of it
+	if (!VRAMS || !VRAM2) {
+		uint32_t caps = MEM_FAST;
+		if (heap_caps_get_free_size(MEM_FAST) < VRAMSIZE * 2 + GFX_CACHE_MIN_FREE_RAM) {
+			MESSAGE_INFO("GFX: Low internal ram, decoded patterns go to psram\n");
+			caps = MEM_SLOW;
+		}
+		VRAMS = VRAMS ?: (uchar *)rg_alloc(VRAMSIZE, caps);
+		VRAM2 = VRAM2 ?: (uchar *)rg_alloc(VRAMSIZE, caps);
+	}
+	sprite_cache_invalidate();
 
 	osd_gfx_init();
 
@@ -119,77 +127,52 @@ gfx_term()
 }
 
 
+//! Latch the current VDC registers, unless a previous latch wasn't rendered yet
 IRAM_ATTR void
-gfx_save_context(char slot_number)
+gfx_latch_context()
 {
-	gfx_context *context;
-
-	// assert(slot_number < 4);
-
-	if (slot_number == 0) {
-		if (gfx_need_redraw == 1) { // Context is already saved + we haven't render the line using it
-			MESSAGE_DEBUG("Cancelled context saving as a previous one wasn't consumed yet\n");
-			return;
-		} else
-			gfx_need_redraw = 1;
+	if (gfx_need_redraw == 1) { // Context is already latched + we haven't render the line using it
+		MESSAGE_DEBUG("Cancelled context saving as a previous one wasn't consumed yet\n");
+		return;
 	}
 
-	context = saved_gfx_context + slot_number;
-
-	context->scroll_x = ScrollX;
-	context->scroll_y = ScrollY;
-	context->scroll_y_diff = ScrollYDiff;
-	context->control = Control;
-
-	TRACE("Saving context %d, scroll = (%d,%d,%d), CR = 0x%02d\n",
-		slot_number, ScrollX, ScrollY, ScrollYDiff, Control);
-}
-
+	gfx_need_redraw = 1;
 
-IRAM_ATTR void
-gfx_load_context(char slot_number)
-{
-	gfx_context *context;
-
-	// assert(slot_number < 4);
-
-	context = saved_gfx_context + slot_number;
-
-	ScrollX = context->scroll_x;
-	ScrollY = context->scroll_y;
-	ScrollYDiff = context->scroll_y_diff;
-	Control = context->control;
+	latched_context.scroll_x = ScrollX;
+	latched_context.scroll_y = ScrollY;
+	latched_context.scroll_y_diff = ScrollYDiff;
+	latched_context.control = Control;
 
-	TRACE("Restoring context %d, scroll = (%d,%d,%d), CR = 0x%02d\n",
-		slot_number, ScrollX, ScrollY, ScrollYDiff, Control);
+	TRACE("Latching context, scroll = (%d,%d,%d), CR = 0x%02d\n",
+		ScrollX, ScrollY, ScrollYDiff, Control);
 }
 
 
 //! Render lines
 /*
 	render lines into the buffer from min_line to max_line (inclusive)
+	using the registers latched when they were last written to
 */
 static inline void
 render_lines(int min_line, int max_line)
 {
+	const gfx_context *context = &latched_context;
+
 	if (osd_skipFrames == 0 && UCount == 0) // Check for frameskip
 	{
-		gfx_save_context(1);
-		gfx_load_context(0);
-
 		// Temp hack
 		if (max_line == 239) max_line = 240;
 
-		if (SpriteON && SPONSwitch)
+		sprite_cache_update();
+
+		if ((context->control & 0x40) && SPONSwitch)
 		{
 			RefreshSpriteExact(min_line, max_line, 0); // max_line + 1
-			RefreshLine(min_line, max_line); // max_line + 1
+			RefreshLine(context, min_line, max_line); // max_line + 1
 			RefreshSpriteExact(min_line, max_line, 1);  // max_line + 1
 		}
 		else
-			RefreshLine(min_line, max_line); // max_line + 1
-
-		gfx_load_context(1);
+			RefreshLine(context, min_line, max_line); // max_line + 1
 	}
 
 	gfx_need_redraw = 0;
@@ -258,7 +241,7 @@ gfx_loop()
 		if (Scanline == io.vdc_minline) {
 			gfx_need_redraw = 0;
 
-			gfx_save_context(0);
+			gfx_latch_context();
 
 			TRACE("GFX: FORCED SAVE OF GFX CONTEXT\n");
 		}
@@ -276,7 +259,7 @@ gfx_loop()
 		}
 	} else if (Scanline < 14 + 242 + 4) {
 		if (Scanline == 14 + 242) {
-			gfx_save_context(0);
+			gfx_latch_context();
 
 			render_lines(last_display_counter, display_counter);
 
@@ -317,6 +300,7 @@ gfx_loop()
 #else
 				memcpy(SPRAM, VRAM + IO_VDC_REG[SATB].W * 2, 64 * 8);
 #endif
+				SPR_CACHE.Lines = 0;
 				// io.vdc_satb = 1;
 				io.vdc_satb = 0;
 				io.vdc_status &= ~VDC_SATBfinish;
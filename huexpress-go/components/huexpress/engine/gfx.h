@@ -1,6 +1,15 @@
 #ifndef _GFX_H_
 #define _GFX_H_
 
+// VDC registers latched for the lines pending render. Defined ahead of the
+// includes because sprite.h (which may pull us in) needs it.
+typedef struct {
+	int16 scroll_x;
+	int16 scroll_y;
+	int16 scroll_y_diff;
+	int16 control;
+} gfx_context;
+
 #include "sprite.h"
 #include "osd.h"
 
@@ -14,18 +23,10 @@
 #define XBUF_WIDTH 	(360 + 32 + 32)
 #define	XBUF_HEIGHT	(240 + 64 + 64)
 
-typedef struct {
-	int16 scroll_x;
-	int16 scroll_y;
-	int16 scroll_y_diff;
-	int16 control;
-} gfx_context;
-
 int  gfx_init();
 void gfx_term();
 void gfx_change_video_mode();
-void gfx_save_context(char slot_number);
-void gfx_load_context(char slot_number);
+void gfx_latch_context();
 char gfx_loop();
 
 extern int UCount;
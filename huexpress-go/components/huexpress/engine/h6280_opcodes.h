@@ -492,8 +492,10 @@ OPCODE_FUNC bbr(uint8 bit)
         reg_pc += 3;
         Cycles += 6;
     } else {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 2) + 3;
         Cycles += 8;
+        idle_loop_check(temp_addr);
     }
 }
 
@@ -501,8 +503,10 @@ OPCODE_FUNC bbs(uint8 bit)
 {
     reg_p &= ~FL_T;
     if (zp_operand(reg_pc + 1) & (1 << bit)) {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 2) + 3;
         Cycles += 8;
+        idle_loop_check(temp_addr);
     } else {
         reg_pc += 3;
         Cycles += 6;
@@ -516,8 +520,10 @@ OPCODE_FUNC bcc(void)
         reg_pc += 2;
         Cycles += 2;
     } else {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 1) + 2;
         Cycles += 4;
+        idle_loop_check(temp_addr);
     }
 }
 
@@ -525,8 +531,10 @@ OPCODE_FUNC bcs(void)
 {
     reg_p &= ~FL_T;
     if (reg_p & FL_C) {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 1) + 2;
         Cycles += 4;
+        idle_loop_check(temp_addr);
     } else {
         reg_pc += 2;
         Cycles += 2;
@@ -537,8 +545,10 @@ OPCODE_FUNC beq(void)
 {
     reg_p &= ~FL_T;
     if (reg_p & FL_Z) {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 1) + 2;
         Cycles += 4;
+        idle_loop_check(temp_addr);
     } else {
         reg_pc += 2;
         Cycles += 2;
@@ -604,8 +614,10 @@ OPCODE_FUNC bmi(void)
 {
     reg_p &= ~FL_T;
     if (reg_p & FL_N) {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 1) + 2;
         Cycles += 4;
+        idle_loop_check(temp_addr);
     } else {
         reg_pc += 2;
         Cycles += 2;
@@ -619,8 +631,10 @@ OPCODE_FUNC bne(void)
         reg_pc += 2;
         Cycles += 2;
     } else {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 1) + 2;
         Cycles += 4;
+        idle_loop_check(temp_addr);
     }
 }
 
@@ -631,16 +645,20 @@ OPCODE_FUNC bpl(void)
         reg_pc += 2;
         Cycles += 2;
     } else {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 1) + 2;
         Cycles += 4;
+        idle_loop_check(temp_addr);
     }
 }
 
 OPCODE_FUNC bra(void)
 {
     reg_p &= ~FL_T;
+    temp_addr = reg_pc;
     reg_pc += (SBYTE) imm_operand(reg_pc + 1) + 2;
     Cycles += 4;
+    idle_loop_check(temp_addr);
 }
 
 OPCODE_FUNC brk(void)
@@ -671,8 +689,10 @@ OPCODE_FUNC bvc(void)
         reg_pc += 2;
         Cycles += 2;
     } else {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 1) + 2;
         Cycles += 4;
+        idle_loop_check(temp_addr);
     }
 }
 
@@ -680,8 +700,10 @@ OPCODE_FUNC bvs(void)
 {
     reg_p &= ~FL_T;
     if (reg_p & FL_V) {
+        temp_addr = reg_pc;
         reg_pc += (SBYTE) imm_operand(reg_pc + 1) + 2;
         Cycles += 4;
+        idle_loop_check(temp_addr);
     } else {
         reg_pc += 2;
         Cycles += 2;
@@ -33,7 +33,7 @@ hard_reset(void)
     uchar *extraram = ExtraRAM;
 
     memset(&PCE, 0, sizeof(PCE));
-	memset(&SPR_CACHE, 0, sizeof(SPR_CACHE));
+	sprite_cache_invalidate();
 
     memcpy(&BackupRAM, BackupRAM_Header, sizeof(BackupRAM_Header));
 
@@ -368,7 +368,7 @@ IO_write(uint16 A, uchar V)
                    if (IO_VDC_REG[BYR].B.l == V)
                    return;
                  */
-                gfx_save_context(0);
+                gfx_latch_context();
 
                 IO_VDC_REG[BYR].B.l = V;
                 ScrollYDiff = Scanline - 1;
@@ -383,7 +383,7 @@ IO_write(uint16 A, uchar V)
                    if (IO_VDC_REG[BXR].B.l == V)
                    return;
                  */
-                gfx_save_context(0);
+                gfx_latch_context();
 
                 IO_VDC_REG[BXR].B.l = V;
                 break;
@@ -392,7 +392,7 @@ IO_write(uint16 A, uchar V)
                 if (IO_VDC_REG_ACTIVE.B.l == V)
                     break;
 
-                gfx_save_context(0);
+                gfx_latch_context();
                 IO_VDC_REG_ACTIVE.B.l = V;
                 break;
 
@@ -413,8 +413,7 @@ IO_write(uint16 A, uchar V)
                 VRAM[IO_VDC_REG[MAWR].W * 2] = io.vdc_ratch;
                 VRAM[IO_VDC_REG[MAWR].W * 2 + 1] = V;
 
-                SPR_CACHE.Planes[IO_VDC_REG[MAWR].W / 16] = 0;
-                SPR_CACHE.Sprites[IO_VDC_REG[MAWR].W / 64] = 0;
+                sprite_cache_touch(IO_VDC_REG[MAWR].W);
 
                 IO_VDC_REG[MAWR].W += io.vdc_inc;
 
@@ -443,6 +442,7 @@ IO_write(uint16 A, uchar V)
 
                     for (int  i = 0; i < (IO_VDC_REG[LENR].W + 1) * 2; i++) {
                         *(VRAM + dest) = *(VRAM + source);
+                        sprite_cache_touch(dest / 2);
                         dest += destcount;
                         source += sourcecount;
                     }
@@ -458,8 +458,6 @@ IO_write(uint16 A, uchar V)
 
                 IO_VDC_REG[LENR].W = 0xFFFF;
 
-                memset(&SPR_CACHE, 0, sizeof(SPR_CACHE));
-
                 /* TODO: check whether this flag can be ignored */
                 io.vdc_status |= VDC_DMAfinish;
                 return;
@@ -469,7 +467,7 @@ IO_write(uint16 A, uchar V)
                     if (IO_VDC_REG[CR].B.h == V)
                     return;
                     */
-                gfx_save_context(0);
+                gfx_latch_context();
 
                 io.vdc_inc = incsize[(V >> 3) & 3];
                 IO_VDC_REG[CR].B.h = V;
@@ -489,7 +487,7 @@ IO_write(uint16 A, uchar V)
                    if (IO_VDC_REG[BYR].B.h == (V & 1))
                    return;
                  */
-                gfx_save_context(0);
+                gfx_latch_context();
                 IO_VDC_REG[BYR].B.h = V & 1;
                 ScrollYDiff = Scanline - 1;
                 ScrollYDiff -= IO_VDC_REG[VPR].B.h + IO_VDC_REG[VPR].B.l;
@@ -512,7 +510,7 @@ IO_write(uint16 A, uchar V)
 
             case BXR:           /* Horizontal screen offset */
                 if (IO_VDC_REG[BXR].B.h != (V & 3)) {
-                    gfx_save_context(0);
+                    gfx_latch_context();
                     IO_VDC_REG[BXR].B.h = V & 3;
                 }
                 return;
@@ -85,9 +85,22 @@ LoadCard(char *name)
 {
 	MESSAGE_INFO("Opening %s...\n", name);
 
-	FILE *fp = fopen(name, "rb");
+	bool zipped = strcasecmp(name + strlen(name) - 4, ".zip") == 0;
+	odroid_zip_t *zip = NULL;
+	FILE *fp = NULL;
+	int fsize = 0;
 
-	if (fp == NULL)
+	if (zipped && (zip = odroid_sdcard_zip_open(name, "pce")))
+	{
+		fsize = odroid_sdcard_zip_size(zip);
+	}
+	else if (!zipped && (fp = odroid_sdcard_fopen(name, "rb")))
+	{
+		// find file size
+		fseek(fp, 0, SEEK_END);
+		fsize = ftell(fp);
+	}
+	else
 	{
 		MESSAGE_ERROR("Failed to open %s!\n", name);
 		return -1;
@@ -97,12 +110,8 @@ LoadCard(char *name)
 		free(ROM);
 	}
 
-	// find file size
-	fseek(fp, 0, SEEK_END);
-	int fsize = ftell(fp);
-
 	// ajust var if header present
-	fseek(fp, fsize & 0x1fff, SEEK_SET);
+	int header = fsize & 0x1fff;
 	fsize &= ~0x1fff;
 
 	// read ROM
@@ -115,11 +124,29 @@ LoadCard(char *name)
 		return -1;
 	}
 
-	fread(ROM, 1, fsize, fp);
+	if (zip)
+	{
+		size_t count = odroid_sdcard_zip_read(zip, header, ROM, fsize);
+		odroid_sdcard_zip_close(zip);
+		if (count < fsize)
+			odroid_system_panic("ROM zip read failed");
+	}
+	else
+	{
+		fseek(fp, header, SEEK_SET);
+		size_t count = fread(ROM, 1, fsize, fp);
+		fclose(fp);
+		if (count < fsize)
+			odroid_system_panic("ROM fread failed");
+	}
 
-	fclose(fp);
+	uint32 CRC = odroid_system_get_rom_crc32(name, "pce", header);
+	if (CRC == 0)
+	{
+		CRC = CRC_buffer(ROM, ROMSIZE * 0x2000);
+		odroid_system_set_rom_crc32(name, header, CRC);
+	}
 
-	uint32 CRC = CRC_buffer(ROM, ROMSIZE * 0x2000);
 	uint16 IDX = 0xFFFF;
 
 	for (int index = 0; index < KNOWN_ROM_COUNT; index++) {
@@ -264,6 +291,24 @@ RunPCE(void)
 }
 
 
+/**
+ * Re-derive what isn't part of a save state
+ */
+static void
+LoadStateDone(void)
+{
+	for(int i = 0; i < 8; i++)
+	{
+		bank_set(i, MMR[i]);
+	}
+
+	// The sprite buckets are rebuilt from the restored SPRAM
+	SPR_CACHE.Lines = 0;
+
+	osd_gfx_set_mode(io.screen_w, io.screen_h);
+}
+
+
 /**
  * Load saved state
  */
@@ -274,7 +319,7 @@ LoadState(char *name)
 
 	char buffer[512];
 
-	FILE *fp = fopen(name, "rb");
+	FILE *fp = odroid_sdcard_fopen(name, "rb");
 	if (fp == NULL)
 		return -1;
 
@@ -293,14 +338,8 @@ LoadState(char *name)
 		fread(SaveStateVars[i].ptr, SaveStateVars[i].len, 1, fp);
 	}
 
-	for(int i = 0; i < 8; i++)
-	{
-		bank_set(i, MMR[i]);
-	}
-
-	memset(&SPR_CACHE, 0, sizeof(SPR_CACHE));
-
-	osd_gfx_set_mode(io.screen_w, io.screen_h);
+	sprite_cache_invalidate();
+	LoadStateDone();
 
 	fclose(fp);
 
@@ -316,7 +355,7 @@ SaveState(char *name)
 {
 	MESSAGE_INFO("Saving state to %s...\n", name);
 
-	FILE *fp = fopen(name, "wb");
+	FILE *fp = odroid_sdcard_fopen(name, "wb");
 	if (fp == NULL)
 		return -1;
 
@@ -334,6 +373,77 @@ SaveState(char *name)
 }
 
 
+/**
+ * Size of a save state, as written by SaveState/SaveStateMem
+ */
+size_t
+SaveStateSize(void)
+{
+	size_t size = sizeof(SAVESTATE_HEADER);
+
+	for (int i = 0; SaveStateVars[i].len > 0; i++)
+	{
+		size += SaveStateVars[i].len;
+	}
+
+	return size;
+}
+
+
+/**
+ * Load saved state from memory, same format as the file
+ */
+int
+LoadStateMem(const void *buffer, size_t size)
+{
+	const uchar *ptr = buffer;
+
+	if (size < SaveStateSize() || memcmp(ptr, SAVESTATE_HEADER, 8) != 0)
+	{
+		MESSAGE_ERROR("Loading state failed: Bad state data\n");
+		return -1;
+	}
+
+	ptr += sizeof(SAVESTATE_HEADER);
+
+	for (int i = 0; SaveStateVars[i].len > 0; i++)
+	{
+		if (SaveStateVars[i].ptr == VRAM)
+			sprite_cache_compare(ptr);
+		memcpy(SaveStateVars[i].ptr, ptr, SaveStateVars[i].len);
+		ptr += SaveStateVars[i].len;
+	}
+
+	LoadStateDone();
+
+	return 0;
+}
+
+
+/**
+ * Save state to memory, returns the number of bytes used or -1
+ */
+int
+SaveStateMem(void *buffer, size_t size)
+{
+	uchar *ptr = buffer;
+
+	if (size < SaveStateSize())
+		return -1;
+
+	memcpy(ptr, SAVESTATE_HEADER, sizeof(SAVESTATE_HEADER));
+	ptr += sizeof(SAVESTATE_HEADER);
+
+	for (int i = 0; SaveStateVars[i].len > 0; i++)
+	{
+		memcpy(ptr, SaveStateVars[i].ptr, SaveStateVars[i].len);
+		ptr += SaveStateVars[i].len;
+	}
+
+	return ptr - (uchar *)buffer;
+}
+
+
 /**
  * Cleanup and quit (not used in retro-go)
  */
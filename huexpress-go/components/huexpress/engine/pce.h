@@ -21,6 +21,9 @@
 int LoadCard(char *name);
 int LoadState(char *name);
 int SaveState(char *name);
+int LoadStateMem(const void *buffer, size_t size);
+int SaveStateMem(void *buffer, size_t size);
+size_t SaveStateSize(void);
 void ResetPCE(bool);
 void RunPCE(void);
 void ShutdownPCE();
@@ -34,6 +37,8 @@ struct host_machine {
 
 	struct {
 		int frameSkip;
+		bool idleSkip;
+		bool spriteLimit;
 		#define BGONSwitch 1
 		#define SPONSwitch 1
 	} options;
@@ -37,13 +37,20 @@
 // PCE sprites and tiles
 uchar *VRAM2, *VRAMS;
 
-// These array are boolean array to know if we must update the
-// corresponding linear sprite representation in VRAM2 and VRAMS or not
-// if (SPR_CACHE.Sprites[5] == 0) 6th pattern in VRAM2 must be updated
+// These are bitmaps to know if we must update the corresponding linear
+// representation in VRAM2 and VRAMS. They are set by VRAM writes and
+// consumed in bulk by sprite_cache_update before any line is rendered:
+// if (SPR_CACHE.Sprites[0] & (1u << 5)) 6th pattern in VRAMS must be updated
 sprite_cache_t SPR_CACHE;
 
 uchar sprite_usespbg = 0;
 
+// Sprites covering each line, split by priority (see sprite_lines_build)
+static uint64 sprite_lines[2][SPR_LINES];
+
+// Whether the sprite limit left some sprites out of some lines
+static bool sprite_lines_clipped = 0;
+
 int ScrollYDiff;
 
 // Actual memory area where the gfx functions are drawing sprites and tiles
@@ -378,6 +385,77 @@ plane2pixel(int no)
 }
 
 
+/*****************************************************************************
+
+        Function: sprite_cache_invalidate
+
+        Description: flag all the tiles and sprites for decoding
+        Parameters: none
+        Return: nothing
+
+*****************************************************************************/
+void
+sprite_cache_invalidate(void)
+{
+    memset(&SPR_CACHE.Planes, 0xFF, sizeof(SPR_CACHE.Planes));
+    memset(&SPR_CACHE.Sprites, 0xFF, sizeof(SPR_CACHE.Sprites));
+    SPR_CACHE.Dirty = 1;
+    SPR_CACHE.Lines = 0;
+}
+
+
+/*****************************************************************************
+
+        Function: sprite_cache_compare
+
+        Description: flag the tiles and sprites whose VRAM differs from vram,
+                     the contents about to replace it. Rewinding loads a state
+                     every few frames, only what changed is decoded again.
+        Parameters: const uchar *vram, VRAMSIZE bytes
+        Return: nothing
+
+*****************************************************************************/
+void
+sprite_cache_compare(const uchar *vram)
+{
+    for (int i = 0; i < VRAMSIZE; i += 32) {
+        if (memcmp(VRAM + i, vram + i, 32) != 0)
+            sprite_cache_touch(i / 2);
+    }
+}
+
+
+/*****************************************************************************
+
+        Function: sprite_cache_update
+
+        Description: decode the tiles and sprites modified since the last call
+        Parameters: none
+        Return: nothing, but updates VRAM2 and VRAMS
+
+*****************************************************************************/
+IRAM_ATTR void
+sprite_cache_update(void)
+{
+    if (!SPR_CACHE.Dirty)
+        return;
+
+    for (int i = 0; i < 2048 / 32; i++) {
+        for (uint32 bits = SPR_CACHE.Planes[i]; bits; bits &= bits - 1)
+            plane2pixel(i * 32 + __builtin_ctz(bits));
+        SPR_CACHE.Planes[i] = 0;
+    }
+
+    for (int i = 0; i < 512 / 32; i++) {
+        for (uint32 bits = SPR_CACHE.Sprites[i]; bits; bits &= bits - 1)
+            sp2pixel(i * 32 + __builtin_ctz(bits));
+        SPR_CACHE.Sprites[i] = 0;
+    }
+
+    SPR_CACHE.Dirty = 0;
+}
+
+
 /*****************************************************************************
 
         Function: RefreshScreen
@@ -403,12 +481,13 @@ RefreshScreen(void)
 		Function: RefreshLine
 
 		Description: draw tiles on screen
-		Parameters: int Y1,int Y2 (lines to draw between)
+		Parameters: gfx_context *context (latched registers),
+			int Y1,int Y2 (lines to draw between)
 		Return: nothing
 
 *****************************************************************************/
 IRAM_ATTR void
-RefreshLine(int Y1, int Y2)
+RefreshLine(const gfx_context *context, int Y1, int Y2)
 {
     int X1, XW, Line;
     int x, y, h, offset;
@@ -421,26 +500,26 @@ RefreshLine(int Y1, int Y2)
             frame);
     }
     TRACE("Rendering lines %3d - %3d\tScroll: (%3d,%3d,%3d)\n",
-        Y1, Y2, ScrollX, ScrollY, ScrollYDiff);
+        Y1, Y2, context->scroll_x, context->scroll_y, context->scroll_y_diff);
 #endif
 
-    if (!(ScreenON && BGONSwitch)) {
+    if (!((context->control & 0x80) && BGONSwitch)) {
         return;
     }
 
     PP = osd_gfx_buffer + XBUF_WIDTH * Y1;
 
-    y = Y1 + ScrollY - ScrollYDiff;
+    y = Y1 + context->scroll_y - context->scroll_y_diff;
     offset = y & 7;
     h = 8 - offset;
     if (h > Y2 - Y1)
         h = Y2 - Y1;
     y >>= 3;
-    PP -= ScrollX & 7;
+    PP -= context->scroll_x & 7;
     XW = io.screen_w / 8 + 1;
 
     for (Line = Y1; Line < Y2; y++) {
-        x = ScrollX / 8;
+        x = context->scroll_x / 8;
         y &= io.bg_h - 1;
         for (X1 = 0; X1 < XW; X1++, x++, PP += 8) {
             uchar *R, *P, *C, *C2;
@@ -463,11 +542,6 @@ RefreshLine(int Y1, int Y2)
 
             no &= 0x7FF;
 
-            if (SPR_CACHE.Planes[no] == 0) {
-                SPR_CACHE.Planes[no] = 1;
-                plane2pixel(no);
-            }
-
             C2 = (VRAM2 + (no * 8 + offset) * 4);
             C = VRAM + (no * 32 + offset * 2);
             P = PP;
@@ -750,6 +824,177 @@ PutSpriteMakeMask(uchar * P, uchar * C, uchar * C2, uchar * R, int16 h,
 }
 
 
+/*****************************************************************************
+
+		Function: sprite_lines_build
+
+		Description: bucket the SATB by the lines each sprite covers, one
+			bitmask (bit n = SATB entry n) per line and per priority.
+			When the sprite limit is enabled, entries past the 16 cells a
+			line can hold are left out of that line like the VDC does.
+		Parameters: none
+		Return: nothing
+
+*****************************************************************************/
+static void
+sprite_lines_build(void)
+{
+    uchar cells[SPR_LINES];
+    SPR *spr = (SPR *) SPRAM;
+
+    memset(sprite_lines, 0, sizeof(sprite_lines));
+    memset(cells, 0, sizeof(cells));
+    sprite_lines_clipped = 0;
+
+    for (int n = 0; n < 64; n++, spr++) {
+        int atr = spr->atr;
+        int y = (spr->y & 1023) - 64;
+        int w = ((atr >> 8) & 1) + 1;
+        int cgy = (atr >> 12) & 3;
+        cgy |= cgy >> 1;
+
+        uint64 *lines = sprite_lines[(atr >> 7) & 1];
+        uint64 bit = 1ULL << n;
+        int y1 = y < 0 ? 0 : y;
+        int y2 = y + (cgy + 1) * 16;
+
+        if (y2 > SPR_LINES)
+            y2 = SPR_LINES;
+
+        for (int line = y1; line < y2; line++) {
+            if (host.options.spriteLimit) {
+                if (cells[line] + w > 16) {
+                    sprite_lines_clipped = 1;
+                    continue;
+                }
+                cells[line] += w;
+            }
+            lines[line] |= bit;
+        }
+    }
+
+    SPR_CACHE.Lines = 1;
+}
+
+
+/*****************************************************************************
+
+		Function: RefreshSprite
+
+		Description: draw one sprite between two lines
+		Parameters: SPR *spr (the SATB entry), int n (its drawing order),
+			int Y1, int Y2 (the 'ordonee' to draw between)
+		Return: nothing
+
+*****************************************************************************/
+static inline void
+RefreshSprite(SPR *spr, int n, int Y1, int Y2)
+{
+    int x, y, no, atr, inc, cgx, cgy;
+    int pos;
+    int h, t, i, j;
+    int y_sum;
+    int spbg;
+    atr = spr->atr;
+    spbg = (atr >> 7) & 1;
+    y = (spr->y & 1023) - 64;
+    x = (spr->x & 1023) - 32;
+    no = spr->no & 2047;
+    // 4095 is for supergraphx only
+    // no = (unsigned int)(spr->no & 4095);
+
+#if ENABLE_TRACING_GFX
+    /*
+       TRACE("Sprite 0x%02X : X = %d, Y = %d, atr = 0x%04X, no = 0x%03X\n",
+       n,
+       x,
+       y,
+       atr,
+       (unsigned long)no);
+     */
+#endif
+
+    cgx = (atr >> 8) & 1;
+    cgy = (atr >> 12) & 3;
+    cgy |= cgy >> 1;
+    no = (no >> 1) & ~(cgy * 2 + cgx);
+    if (x >= io.screen_w || x + (cgx + 1) * 16 < 0) {
+        return;
+    }
+
+    uchar* R = &Palette[256 + ((atr & 15) << 4)];
+    uchar* C = VRAM + (no * 128);
+    uchar* C2 = VRAMS + (no * 32) * 4;  /* TEST */
+    pos = XBUF_WIDTH * (y + 0) + x;
+    inc = 2;
+    if (atr & V_FLIP) {
+        inc = -2;
+        C += 15 * 2 + cgy * 256;
+        C2 += (15 * 2 + cgy * 64) * 4;
+    }
+    y_sum = 0;
+
+    for (i = 0; i <= cgy; i++) {
+        t = Y1 - y - y_sum;
+        h = 16;
+        if (t > 0) {
+            C += t * inc;
+            C2 += (t * inc) * 4;
+            h -= t;
+            pos += t * XBUF_WIDTH;
+        }
+        if (h > Y2 - y - y_sum)
+            h = Y2 - y - y_sum;
+        if (spbg == 0) {
+            sprite_usespbg = 1;
+            if (atr & H_FLIP) {
+                for (j = 0; j <= cgx; j++) {
+                    PutSpriteHflipMakeMask(osd_gfx_buffer + pos
+                        + (cgx - j) * 16, C + j * 128, C2 + j * 32 * 4, R,
+                        h, inc, SPM + pos + (cgx - j) * 16, n);
+                }
+            } else {
+                for (j = 0; j <= cgx; j++) {
+                    PutSpriteMakeMask(osd_gfx_buffer + pos + (j) * 16,
+                        C + j * 128, C2 + j * 32 * 4, R, h, inc,
+                        SPM + pos + j * 16, n);
+                }
+            }
+        } else if (sprite_usespbg) {
+            if (atr & H_FLIP) {
+                for (j = 0; j <= cgx; j++) {
+                    PutSpriteHflipM(osd_gfx_buffer + pos + (cgx - j) * 16,
+                        C + j * 128, C2 + j * 32 * 4, R,
+                        h, inc, SPM + pos + (cgx - j) * 16, n);
+                }
+            } else {
+                for (j = 0; j <= cgx; j++) {
+                    PutSpriteM(osd_gfx_buffer + pos + (j) * 16,
+                        C + j * 128, C2 + j * 32 * 4, R, h, inc,
+                        SPM + pos + j * 16, n);
+                }
+            }
+        } else {
+            if (atr & H_FLIP) {
+                for (j = 0; j <= cgx; j++) {
+                    PutSpriteHflip(osd_gfx_buffer + pos + (cgx - j) * 16,
+                        C + j * 128, C2 + j * 32 * 4, R, h, inc);
+                }
+            } else {
+                for (j = 0; j <= cgx; j++) {
+                    PutSprite(osd_gfx_buffer + pos + (j) * 16,
+                        C + j * 128, C2 + j * 32 * 4, R, h, inc);
+                }
+            }
+        }
+        pos += h * XBUF_WIDTH;
+        C += h * inc + 16 * 7 * inc;
+        C2 += (h * inc + 16 * inc) * 4;
+        y_sum += 16;
+    }
+}
+
+
 /*****************************************************************************
 
 		Function: RefreshSpriteExact
@@ -763,129 +1008,44 @@ PutSpriteMakeMask(uchar * P, uchar * C, uchar * C2, uchar * R, int16 h,
 IRAM_ATTR void
 RefreshSpriteExact(int Y1, int Y2, uchar bg)
 {
-    int n;
-    SPR *spr;
+    uint64 *lines = sprite_lines[bg];
+    uint64 mask = 0;
 
-    spr = (SPR *) SPRAM + 63;
+    if (SPR_CACHE.Lines == 0)
+        sprite_lines_build();
 
     if (bg == 0)
         sprite_usespbg = 0;
 
-    for (n = 0; n < 64; n++, spr--) {
-        int x, y, no, atr, inc, cgx, cgy;
-        int pos;
-        int h, t, i, j;
-        int y_sum;
-        int spbg;
-        atr = spr->atr;
-        spbg = (atr >> 7) & 1;
-        if (spbg != bg)
-            continue;
-        y = (spr->y & 1023) - 64;
-        x = (spr->x & 1023) - 32;
+    if (Y1 < 0)
+        Y1 = 0;
+    if (Y2 > SPR_LINES)
+        Y2 = SPR_LINES;
 
-        no = spr->no & 2047;
-        // 4095 is for supergraphx only
-        // no = (unsigned int)(spr->no & 4095);
+    for (int line = Y1; line < Y2; line++)
+        mask |= lines[line];
 
-#if ENABLE_TRACING_GFX
-        /*
-           TRACE("Sprite 0x%02X : X = %d, Y = %d, atr = 0x%04X, no = 0x%03X\n",
-           n,
-           x,
-           y,
-           atr,
-           (unsigned long)no);
-         */
-#endif
+    // Entry 63 is drawn first so that entry 0 ends up on top
+    while (mask) {
+        int no = 63 - __builtin_clzll(mask);
+        SPR *spr = (SPR *) SPRAM + no;
+        mask &= ~(1ULL << no);
 
-        cgx = (atr >> 8) & 1;
-        cgy = (atr >> 12) & 3;
-        cgy |= cgy >> 1;
-        no = (no >> 1) & ~(cgy * 2 + cgx);
-        if (y >= Y2 || y + (cgy + 1) * 16 < Y1 || x >= io.screen_w
-            || x + (cgx + 1) * 16 < 0) {
+        if (!sprite_lines_clipped) {
+            RefreshSprite(spr, 63 - no, Y1, Y2);
             continue;
         }
 
-        for (i = 0; i < cgy * 2 + cgx + 1; i++) {
-            if (SPR_CACHE.Sprites[no + i] == 0) {
-                SPR_CACHE.Sprites[no + i] = 1;
-                sp2pixel(no + i);
-            }
-            if (!cgx)
-                i++;
-        }
-
-        uchar* R = &Palette[256 + ((atr & 15) << 4)];
-        uchar* C = VRAM + (no * 128);
-        uchar* C2 = VRAMS + (no * 32) * 4;  /* TEST */
-        pos = XBUF_WIDTH * (y + 0) + x;
-        inc = 2;
-        if (atr & V_FLIP) {
-            inc = -2;
-            C += 15 * 2 + cgy * 256;
-            C2 += (15 * 2 + cgy * 64) * 4;
-        }
-        y_sum = 0;
-
-        for (i = 0; i <= cgy; i++) {
-            t = Y1 - y - y_sum;
-            h = 16;
-            if (t > 0) {
-                C += t * inc;
-                C2 += (t * inc) * 4;
-                h -= t;
-                pos += t * XBUF_WIDTH;
-            }
-            if (h > Y2 - y - y_sum)
-                h = Y2 - y - y_sum;
-            if (spbg == 0) {
-                sprite_usespbg = 1;
-                if (atr & H_FLIP) {
-                    for (j = 0; j <= cgx; j++) {
-                        PutSpriteHflipMakeMask(osd_gfx_buffer + pos
-                            + (cgx - j) * 16, C + j * 128, C2 + j * 32 * 4, R,
-                            h, inc, SPM + pos + (cgx - j) * 16, n);
-                    }
-                } else {
-                    for (j = 0; j <= cgx; j++) {
-                        PutSpriteMakeMask(osd_gfx_buffer + pos + (j) * 16,
-                            C + j * 128, C2 + j * 32 * 4, R, h, inc,
-                            SPM + pos + j * 16, n);
-                    }
-                }
-            } else if (sprite_usespbg) {
-                if (atr & H_FLIP) {
-                    for (j = 0; j <= cgx; j++) {
-                        PutSpriteHflipM(osd_gfx_buffer + pos + (cgx - j) * 16,
-                            C + j * 128, C2 + j * 32 * 4, R,
-                            h, inc, SPM + pos + (cgx - j) * 16, n);
-                    }
-                } else {
-                    for (j = 0; j <= cgx; j++) {
-                        PutSpriteM(osd_gfx_buffer + pos + (j) * 16,
-                            C + j * 128, C2 + j * 32 * 4, R, h, inc,
-                            SPM + pos + j * 16, n);
-                    }
-                }
-            } else {
-                if (atr & H_FLIP) {
-                    for (j = 0; j <= cgx; j++) {
-                        PutSpriteHflip(osd_gfx_buffer + pos + (cgx - j) * 16,
-                            C + j * 128, C2 + j * 32 * 4, R, h, inc);
-                    }
-                } else {
-                    for (j = 0; j <= cgx; j++) {
-                        PutSprite(osd_gfx_buffer + pos + (j) * 16,
-                            C + j * 128, C2 + j * 32 * 4, R, h, inc);
-                    }
-                }
+        // Draw only the runs of lines on which the sprite wasn't dropped
+        for (int line = Y1; line < Y2;) {
+            if (!(lines[line] & (1ULL << no))) {
+                line++;
+                continue;
             }
-            pos += h * XBUF_WIDTH;
-            C += h * inc + 16 * 7 * inc;
-            C2 += (h * inc + 16 * inc) * 4;
-            y_sum += 16;
+            int start = line;
+            while (line < Y2 && (lines[line] & (1ULL << no)))
+                line++;
+            RefreshSprite(spr, 63 - no, start, line);
         }
     }
 }
@@ -33,12 +33,25 @@ typedef struct {
 
 typedef struct
 {
-	bool Planes[2048];
-	bool Sprites[512];
+	// Bit n is set when tile/sprite pattern n must be decoded again
+	uint32 Planes[2048 / 32];
+	uint32 Sprites[512 / 32];
+	bool Dirty;
+	bool Lines;
 } sprite_cache_t;
 
 extern sprite_cache_t SPR_CACHE;
 
+// Flag the patterns covering the VRAM word at addr for decoding
+static inline void
+sprite_cache_touch(uint16 addr)
+{
+	addr &= 0x7FFF;
+	SPR_CACHE.Planes[addr / 512] |= 1u << ((addr / 16) & 31);
+	SPR_CACHE.Sprites[addr / 2048] |= 1u << ((addr / 64) & 31);
+	SPR_CACHE.Dirty = 1;
+}
+
 extern uchar *SPM;
 
 extern uchar *VRAM2, *VRAMS;
@@ -46,11 +59,17 @@ extern uchar *VRAM2, *VRAMS;
 
 extern int ScrollYDiff;
 
+// Lines covered by the sprite buckets
+#define SPR_LINES 256
+
 #define V_FLIP  0x8000
 #define H_FLIP  0x0800
 
 // The true refreshing function
-extern void RefreshLine(int Y1, int Y2);
+extern void sprite_cache_invalidate(void);
+extern void sprite_cache_compare(const uchar *vram);
+extern void sprite_cache_update(void);
+extern void RefreshLine(const gfx_context *context, int Y1, int Y2);
 extern void RefreshSpriteExact(int Y1, int Y2, uchar bg);
 extern int32 CheckSprites(void);
 extern void RefreshScreen(void);
@@ -6,6 +6,17 @@
 #define ENABLE_TRACING_SPRITE 0
 #define ENABLE_TRACING_SND 0
 
+/* Fast-forward the cpu through loops that only poll for the next line/irq */
+#define ENABLE_IDLE_LOOP_SKIP 1
+
+/* Use a computed goto table instead of a switch to dispatch cpu opcodes.
+   Off until it has been measured on the device against the switch. */
+#define ENABLE_COMPUTED_GOTO 0
+
+/* Internal ram (bytes) that must remain free for the decoded tile/sprite
+   cache (2 x 64KB) to be allocated there instead of psram */
+#define GFX_CACHE_MIN_FREE_RAM (32 * 1024)
+
 /* defined if user wants netplay support */
 /* #undef ENABLE_NETPLAY */
 
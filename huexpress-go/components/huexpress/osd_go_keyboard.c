@@ -6,13 +6,84 @@
 /*		ducalex                          */
 /*****************************************/
 
-#include <odroid_input.h>
-#include "hard_pce.h"
+#include <odroid_system.h>
+#include <stdio.h>
+#include <string.h>
+#include "pce.h"
 #include "osd.h"
 
+#define NVS_KEY_IDLE_SKIP "IdleSkip"
+#define NVS_KEY_SPRITE_LIMIT "SpriteLimit"
+
+static char idle_skip_key[16];
+
+
+static void update_idle_skip(void)
+{
+    // Per-title override (-1 = follow the global setting)
+    int value = odroid_settings_int32_get(idle_skip_key, -1);
+    if (value < 0) {
+        value = odroid_settings_app_int32_get(NVS_KEY_IDLE_SKIP, 1);
+    }
+    host.options.idleSkip = value != 0;
+}
+
+
+static bool idle_skip_default_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t event)
+{
+    int value = odroid_settings_app_int32_get(NVS_KEY_IDLE_SKIP, 1);
+
+    if (event == ODROID_DIALOG_PREV || event == ODROID_DIALOG_NEXT) {
+        value = !value;
+        odroid_settings_app_int32_set(NVS_KEY_IDLE_SKIP, value);
+        update_idle_skip();
+    }
+
+    strcpy(option->value, value ? "On" : "Off");
+
+    return event == ODROID_DIALOG_ENTER;
+}
+
+
+static bool idle_skip_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t event)
+{
+    int value = odroid_settings_int32_get(idle_skip_key, -1);
+
+    if (event == ODROID_DIALOG_PREV && --value < -1) value = 1;
+    if (event == ODROID_DIALOG_NEXT && ++value > 1) value = -1;
+
+    if (event == ODROID_DIALOG_PREV || event == ODROID_DIALOG_NEXT) {
+        odroid_settings_int32_set(idle_skip_key, value);
+        update_idle_skip();
+    }
+
+    if (value == -1) strcpy(option->value, host.options.idleSkip ? "Default (On)" : "Default (Off)");
+    if (value == 0)  strcpy(option->value, "Off");
+    if (value == 1)  strcpy(option->value, "On");
+
+    return event == ODROID_DIALOG_ENTER;
+}
+
+
+static bool sprite_limit_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t event)
+{
+    if (event == ODROID_DIALOG_PREV || event == ODROID_DIALOG_NEXT) {
+        host.options.spriteLimit = !host.options.spriteLimit;
+        odroid_settings_app_int32_set(NVS_KEY_SPRITE_LIMIT, host.options.spriteLimit);
+        SPR_CACHE.Lines = 0; // Rebuild the sprite buckets
+    }
+
+    strcpy(option->value, host.options.spriteLimit ? "On" : "Off");
+
+    return event == ODROID_DIALOG_ENTER;
+}
+
 
 int osd_init_input(void)
 {
+    sprintf(idle_skip_key, "Idle.%08X", odroid_system_get_game_id());
+    update_idle_skip();
+    host.options.spriteLimit = odroid_settings_app_int32_get(NVS_KEY_SPRITE_LIMIT, 0);
     return 0;
 }
 
@@ -25,9 +96,17 @@ int osd_keyboard(void)
 		odroid_overlay_game_menu();
 	}
 	else if (joystick.values[ODROID_INPUT_VOLUME]) {
-		odroid_overlay_game_settings_menu(NULL);
+		odroid_dialog_choice_t options[] = {
+			{99, "Idle skip (all)", "On", 1, &idle_skip_default_cb},
+			{100, "Idle skip (game)", "On", 1, &idle_skip_cb},
+			{101, "Sprite limit", "Off", 1, &sprite_limit_cb},
+			ODROID_DIALOG_CHOICE_LAST
+		};
+		odroid_overlay_game_settings_menu(options);
 	}
 
+    odroid_system_rewind_tick(&joystick);
+
     uint8_t rc = 0;
     if (joystick.values[ODROID_INPUT_LEFT]) rc |= JOY_LEFT;
     if (joystick.values[ODROID_INPUT_RIGHT]) rc |= JOY_RIGHT;
@@ -24,6 +24,22 @@ static bool save_state(char *pathName)
 }
 
 
+static size_t save_state_mem(void *buffer, size_t size)
+{
+    if (buffer == NULL)
+        return SaveStateSize();
+
+    int len = SaveStateMem(buffer, size);
+    return len > 0 ? len : 0;
+}
+
+
+static size_t load_state_mem(void *buffer, size_t size)
+{
+    return LoadStateMem(buffer, size) == 0 ? size : 0;
+}
+
+
 static bool load_state(char *pathName)
 {
     if (LoadState(pathName) != 0)
@@ -41,6 +57,7 @@ void app_main(void)
 
     odroid_system_init(APP_ID, AUDIO_SAMPLE_RATE);
     odroid_system_emu_init(&load_state, &save_state, NULL);
+    odroid_system_emu_set_state_mem_handler(&load_state_mem, &save_state_mem);
 
     char *romFile = odroid_system_get_path(NULL, ODROID_PATH_ROM_FILE);
 
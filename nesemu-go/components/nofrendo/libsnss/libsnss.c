@@ -201,10 +201,29 @@ SNSS_WriteFileHeader (SNSS_FILE *snssFile)
 /**************************************************************************/
 SNSS_RETURN_CODE
 SNSS_OpenFile (SNSS_FILE **snssFile, const char *filename, SNSS_OPEN_MODE mode)
+{
+   FILE *fp;
+
+   fp = fopen (filename, (SNSS_OPEN_READ == mode) ? "rb" : "wb");
+   if (NULL == fp)
+   {
+      *snssFile = NULL;
+      return SNSS_OPEN_FAILED;
+   }
+
+   return SNSS_OpenStream (snssFile, fp, mode);
+}
+
+/**************************************************************************/
+
+/* takes ownership of fp, which SNSS_CloseFile will fclose */
+SNSS_RETURN_CODE
+SNSS_OpenStream (SNSS_FILE **snssFile, FILE *fp, SNSS_OPEN_MODE mode)
 {
    *snssFile = malloc(sizeof(SNSS_FILE));
    if (NULL == *snssFile)
    {
+      fclose (fp);
       return SNSS_OUT_OF_MEMORY;
    }
 
@@ -212,23 +231,7 @@ SNSS_OpenFile (SNSS_FILE **snssFile, const char *filename, SNSS_OPEN_MODE mode)
    memset (*snssFile, 0, sizeof(SNSS_FILE));
 
    (*snssFile)->mode = mode;
-
-   if (SNSS_OPEN_READ == mode)
-   {
-      (*snssFile)->fp = fopen (filename, "rb");
-   }
-   else
-   {
-      (*snssFile)->fp = fopen (filename, "wb");
-      (*snssFile)->headerBlock.numberOfBlocks = 0;
-   }
-
-   if (NULL == (*snssFile)->fp)
-   {
-      free(*snssFile);
-      *snssFile = NULL;
-      return SNSS_OPEN_FAILED;
-   }
+   (*snssFile)->fp = fp;
 
    if (SNSS_OPEN_READ == mode)
    {
@@ -236,6 +239,7 @@ SNSS_OpenFile (SNSS_FILE **snssFile, const char *filename, SNSS_OPEN_MODE mode)
    }
    else
    {
+      (*snssFile)->headerBlock.numberOfBlocks = 0;
       return SNSS_WriteFileHeader(*snssFile);
    }
 }
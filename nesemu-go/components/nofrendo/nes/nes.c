@@ -271,6 +271,12 @@ void nes_emulate(void)
    }
 }
 
+/* Emulates a frame without drawing it, used by netplay to catch up */
+void nes_skipframe(void)
+{
+   nes_renderframe(false);
+}
+
 static void mem_reset(uint8 *buffer, int length, int reset_type)
 {
    if (!buffer) return;
@@ -106,6 +106,7 @@ extern void nes_destroy();
 extern int nes_insertcart(const char *filename, nes_t *machine);
 extern void nes_setregion(region_t region, nes_t *machine);
 extern void nes_emulate(void);
+extern void nes_skipframe(void);
 extern void nes_reset(int reset_type);
 extern void nes_poweroff(void);
 extern void nes_togglepause(void);
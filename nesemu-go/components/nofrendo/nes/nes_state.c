@@ -31,6 +31,7 @@
 #include <nes.h>
 #include <osd.h>
 #include <libsnss.h>
+#include <odroid_sdcard.h>
 #include "nes6502.h"
 
 extern nes6502_context cpu;
@@ -348,159 +349,169 @@ void load_mapperblock(nes_t *state, SNSS_FILE *snssFile)
 }
 
 
-int state_save(char* fn)
+static SNSS_RETURN_CODE state_save_blocks(nes_t *machine, SNSS_FILE *snssFile)
 {
-   SNSS_FILE *snssFile;
-   SNSS_RETURN_CODE status;
-
-   nes_t *machine;
-
-   /* get the pointer to our NES machine context */
-   machine = console;
-   ASSERT(machine);
-
-   printf("state_save: fn='%s'\n", fn);
+   SNSS_RETURN_CODE status = SNSS_OK;
 
-   /* open our state file for writing */
-   status = SNSS_OpenFile(&snssFile, fn, SNSS_OPEN_WRITE);
-   if (SNSS_OK != status)
-      return -1;
-
-   printf("state_save: SNSS_OpenFile OK\n");
-
-   /* now get all of our blocks */
    if (0 == save_baseblock(machine, snssFile))
    {
       status = SNSS_WriteBlock(snssFile, SNSS_BASR);
       if (SNSS_OK != status)
-         goto _error;
-      printf("  - save_baseblock OK\n");
+         return status;
    }
 
    if (0 == save_vramblock(machine, snssFile))
    {
       status = SNSS_WriteBlock(snssFile, SNSS_VRAM);
       if (SNSS_OK != status)
-         goto _error;
-      printf("  - save_vramblock OK\n");
+         return status;
    }
 
    if (0 == save_sramblock(machine, snssFile))
    {
       status = SNSS_WriteBlock(snssFile, SNSS_SRAM);
       if (SNSS_OK != status)
-         goto _error;
-      printf("  - save_sramblock OK\n");
+         return status;
    }
 
    if (0 == save_soundblock(machine, snssFile))
    {
       status = SNSS_WriteBlock(snssFile, SNSS_SOUN);
       if (SNSS_OK != status)
-         goto _error;
-      printf("  - save_soundblock OK\n");
+         return status;
    }
 
    if (0 == save_mapperblock(machine, snssFile))
    {
       status = SNSS_WriteBlock(snssFile, SNSS_MPRD);
       if (SNSS_OK != status)
-         goto _error;
-      printf("  - save_mapperblock OK\n");
+         return status;
    }
 
-   /* close the file, we're done */
-   status = SNSS_CloseFile(&snssFile);
-   if (SNSS_OK != status)
-      goto _error;
-
-   printf("state_save: Game %d saved\n", state_slot);
-   return 0;
-
-_error:
-   printf("state_save: Failed: %s\n", SNSS_GetErrorString(status));
-   SNSS_CloseFile(&snssFile);
-   return -1;
+   return status;
 }
 
 
-int state_load(char* fn)
+static SNSS_RETURN_CODE state_load_blocks(nes_t *machine, SNSS_FILE *snssFile)
 {
-   SNSS_FILE *snssFile;
-   SNSS_RETURN_CODE status;
+   SNSS_RETURN_CODE status = SNSS_OK;
    SNSS_BLOCK_TYPE block_type;
-
    unsigned int i;
-   nes_t *machine;
-   nes_t nes;
-
-   /* get our machine's context pointer */
-   machine = console;
-
-   ASSERT(machine);
-
-   /* open our file for reading */
-   status = SNSS_OpenFile(&snssFile, fn, SNSS_OPEN_READ);
-   if (SNSS_OK != status)
-   {
-       printf("state_load: file '%s' could not be opened.\n", fn);
-       return -1; //goto _error;
-  }
-
-   printf("state_load: file '%s' opened.\n", fn);
-
-   /* iterate through all present blocks */
-   printf("state_load: snssFile->headerBlock.numberOfBlocks=%d\n", snssFile->headerBlock.numberOfBlocks);
 
    for (i = 0; i < snssFile->headerBlock.numberOfBlocks; i++)
    {
       status = SNSS_GetNextBlockType(&block_type, snssFile);
       if (SNSS_OK != status)
-         goto _error;
+         return status;
 
       status = SNSS_ReadBlock(snssFile, block_type);
       if (SNSS_OK != status)
-         goto _error;
+         return status;
 
       switch (block_type)
       {
       case SNSS_BASR:
-         printf("  - load_baseblock\n");
          load_baseblock(machine, snssFile);
          break;
 
       case SNSS_VRAM:
-         printf("  - load_vramblock\n");
          load_vramblock(machine, snssFile);
          break;
 
       case SNSS_SRAM:
-         printf("  - load_sramblock\n");
          load_sramblock(machine, snssFile);
          break;
 
       case SNSS_MPRD:
-         printf("  - load_mapperblock\n");
          load_mapperblock(machine, snssFile);
          break;
 
       case SNSS_CNTR:
-         printf("  - load_controllerblock\n");
          load_controllerblock(machine, snssFile);
          break;
 
       case SNSS_SOUN:
-         printf("  - load_soundblock\n");
          load_soundblock(machine, snssFile);
          break;
 
       case SNSS_UNKNOWN_BLOCK:
       default:
-         printf("  - unknown SNSS block type\n");
+         printf("state_load: unknown SNSS block type\n");
          break;
       }
    }
 
+   return status;
+}
+
+
+int state_save(char* fn)
+{
+   SNSS_FILE *snssFile;
+   SNSS_RETURN_CODE status;
+
+   nes_t *machine;
+
+   /* get the pointer to our NES machine context */
+   machine = console;
+   ASSERT(machine);
+
+   printf("state_save: fn='%s'\n", fn);
+
+   /* open our state file for writing */
+   FILE *fp = odroid_sdcard_fopen(fn, "wb");
+   status = fp ? SNSS_OpenStream(&snssFile, fp, SNSS_OPEN_WRITE) : SNSS_OPEN_FAILED;
+   if (SNSS_OK != status)
+      return -1;
+
+   /* now get all of our blocks */
+   status = state_save_blocks(machine, snssFile);
+   if (SNSS_OK != status)
+      goto _error;
+
+   /* close the file, we're done */
+   status = SNSS_CloseFile(&snssFile);
+   if (SNSS_OK != status)
+      goto _error;
+
+   printf("state_save: Game %d saved\n", state_slot);
+   return 0;
+
+_error:
+   printf("state_save: Failed: %s\n", SNSS_GetErrorString(status));
+   SNSS_CloseFile(&snssFile);
+   return -1;
+}
+
+
+int state_load(char* fn)
+{
+   SNSS_FILE *snssFile;
+   SNSS_RETURN_CODE status;
+
+   nes_t *machine;
+
+   /* get our machine's context pointer */
+   machine = console;
+
+   ASSERT(machine);
+
+   /* open our file for reading */
+   FILE *fp = odroid_sdcard_fopen(fn, "rb");
+   status = fp ? SNSS_OpenStream(&snssFile, fp, SNSS_OPEN_READ) : SNSS_OPEN_FAILED;
+   if (SNSS_OK != status)
+   {
+       printf("state_load: file '%s' could not be opened.\n", fn);
+       return -1; //goto _error;
+   }
+
+   printf("state_load: file '%s' opened.\n", fn);
+
+   /* iterate through all present blocks */
+   status = state_load_blocks(machine, snssFile);
+   if (SNSS_OK != status)
+      goto _error;
+
    /* close file, we're done */
    status = SNSS_CloseFile(&snssFile);
 
@@ -513,3 +524,80 @@ _error:
    SNSS_CloseFile(&snssFile);
    abort();
 }
+
+
+/* Upper bound of what state_save_mem will write */
+int state_mem_size(void)
+{
+   return 8 + 5 * 12 + BASE_BLOCK_LENGTH + VRAM_16K + 1 + SRAM_8K
+      + MAPPER_BLOCK_LENGTH + SOUND_BLOCK_LENGTH;
+}
+
+
+/* Same format as state_save, returns the number of bytes used */
+int state_save_mem(void *buffer, int size)
+{
+   SNSS_FILE *snssFile;
+   SNSS_RETURN_CODE status;
+   FILE *fp;
+   int len;
+
+   ASSERT(console);
+
+   if (size < state_mem_size())
+      return -1;
+
+   if (NULL == (fp = fmemopen(buffer, size, "wb")))
+      return -1;
+
+   status = SNSS_OpenStream(&snssFile, fp, SNSS_OPEN_WRITE);
+   if (SNSS_OK != status)
+      goto _error;
+
+   status = state_save_blocks(console, snssFile);
+   if (SNSS_OK != status)
+      goto _error;
+
+   len = ftell(snssFile->fp);
+
+   status = SNSS_CloseFile(&snssFile);
+   if (SNSS_OK != status)
+      goto _error;
+
+   return len;
+
+_error:
+   printf("state_save_mem: Failed: %s\n", SNSS_GetErrorString(status));
+   SNSS_CloseFile(&snssFile);
+   return -1;
+}
+
+
+int state_load_mem(const void *buffer, int size)
+{
+   SNSS_FILE *snssFile;
+   SNSS_RETURN_CODE status;
+   FILE *fp;
+
+   ASSERT(console);
+
+   if (NULL == (fp = fmemopen((void *)buffer, size, "rb")))
+      return -1;
+
+   status = SNSS_OpenStream(&snssFile, fp, SNSS_OPEN_READ);
+   if (SNSS_OK != status)
+      goto _error;
+
+   status = state_load_blocks(console, snssFile);
+   if (SNSS_OK != status)
+      goto _error;
+
+   SNSS_CloseFile(&snssFile);
+
+   return 0;
+
+_error:
+   printf("state_load_mem: Failed: %s\n", SNSS_GetErrorString(status));
+   SNSS_CloseFile(&snssFile);
+   return -1;
+}
@@ -31,5 +31,8 @@
 extern void state_setslot(int slot);
 int state_load(char* fn);
 int state_save(char* fn);
+int state_mem_size(void);
+int state_load_mem(const void *buffer, int size);
+int state_save_mem(void *buffer, int size);
 
 #endif /* _NESSTATE_H_ */
@@ -89,6 +89,20 @@ static bool SaveState(char *pathName)
    return state_save(pathName) >= 0;
 }
 
+static size_t SaveStateMem(void *buffer, size_t size)
+{
+   if (buffer == NULL)
+      return state_mem_size();
+
+   int len = state_save_mem(buffer, size);
+   return len > 0 ? len : 0;
+}
+
+static size_t LoadStateMem(void *buffer, size_t size)
+{
+   return state_load_mem(buffer, size) < 0 ? 0 : size;
+}
+
 static bool LoadState(char *pathName)
 {
    if (state_load(pathName) < 0)
@@ -289,7 +303,7 @@ void IRAM_ATTR osd_blitscreen(bitmap_t *bmp)
    currentUpdate = previousUpdate;
 }
 
-void osd_getinput(void)
+static void osd_setinput(void)
 {
 	static const int events[] = {
       event_joypad1_start, event_joypad1_select, event_joypad1_up, event_joypad1_right,
@@ -302,24 +316,6 @@ void osd_getinput(void)
    static uint16 previous = 0xffff;
    uint16 b = 0, changed = 0;
 
-   odroid_input_gamepad_read(localJoystick);
-
-   if (localJoystick->values[ODROID_INPUT_MENU]) {
-      odroid_overlay_game_menu();
-   }
-   else if (localJoystick->values[ODROID_INPUT_VOLUME]) {
-      odroid_dialog_choice_t options[] = {
-            {100, "Palette", "Default", 1, &palette_update_cb},
-            {101, "More...", "", 1, &advanced_settings_cb},
-            ODROID_DIALOG_CHOICE_LAST
-      };
-      odroid_overlay_game_settings_menu(options);
-   }
-
-   if (netplay) {
-      odroid_netplay_sync(localJoystick, remoteJoystick, sizeof(odroid_gamepad_state));
-   }
-
 	if (!joystick1.values[ODROID_INPUT_START])  b |= (1 << 0);
 	if (!joystick1.values[ODROID_INPUT_SELECT]) b |= (1 << 1);
 	if (!joystick1.values[ODROID_INPUT_UP])     b |= (1 << 2);
@@ -349,6 +345,44 @@ void osd_getinput(void)
 	}
 }
 
+void osd_getinput(void)
+{
+   odroid_input_gamepad_read(localJoystick);
+
+   if (localJoystick->values[ODROID_INPUT_MENU]) {
+      odroid_overlay_game_menu();
+   }
+   else if (localJoystick->values[ODROID_INPUT_VOLUME]) {
+      odroid_dialog_choice_t options[] = {
+            {100, "Palette", "Default", 1, &palette_update_cb},
+            {101, "More...", "", 1, &advanced_settings_cb},
+            ODROID_DIALOG_CHOICE_LAST
+      };
+      odroid_overlay_game_settings_menu(options);
+   }
+
+   odroid_system_rewind_tick(localJoystick);
+
+   if (netplay) {
+      odroid_netplay_sync(localJoystick, remoteJoystick, sizeof(odroid_gamepad_state));
+   }
+
+   osd_setinput();
+}
+
+// Netplay rollback, runs a frame again with corrected inputs
+static void netplay_run_frame(void *local, void *remote)
+{
+   memcpy(localJoystick, local, sizeof(odroid_gamepad_state));
+   memcpy(remoteJoystick, remote, sizeof(odroid_gamepad_state));
+   osd_setinput();
+
+   nes_skipframe();
+
+   // The apu must keep up, its samples are simply not played
+   audio_callback(audioBuffer, AUDIO_SAMPLE_RATE / nes_getptr()->refresh_rate);
+}
+
 
 void app_main(void)
 {
@@ -356,6 +390,8 @@ void app_main(void)
 
    odroid_system_init(APP_ID, AUDIO_SAMPLE_RATE);
    odroid_system_emu_init(&LoadState, &SaveState, &netplay_callback);
+   odroid_system_emu_set_state_mem_handler(&LoadStateMem, &SaveStateMem);
+   odroid_netplay_set_rollback(&netplay_run_frame);
 
    audioBuffer = rg_alloc(AUDIO_SAMPLE_RATE / 50 * 4, MEM_DMA);
    romData     = rg_alloc(1024 * 1024, MEM_ANY);
@@ -366,7 +402,7 @@ void app_main(void)
    if (strcasecmp(romPath + (strlen(romPath) - 4), ".zip") == 0)
    {
       printf("app_main ROM: Reading compressed file: %s\n", romPath);
-      romSize = odroid_sdcard_unzip_file_to_memory(romPath, romData, 1024 * 1024);
+      romSize = odroid_sdcard_unzip_file_to_memory(romPath, "nes", romData, 1024 * 1024);
    }
    else
    {
@@ -199,6 +199,19 @@ typedef struct {
     /* the output image */
     LuImage *img;
     const LuImage *cimg; /* constant pointer version */
+
+    /* row mode: RGB565 rows are handed to rowProc instead of filling img */
+    PngRowProc rowProc;
+    void *rowProcUserPtr;
+    uint32_t rowMaxWidth;
+    uint32_t rowMaxHeight;
+    int32_t rowScale;
+    int32_t rowWidth;
+    int32_t rowHeight;
+    uint32_t *rowSums;  /* box filter sums of the output row, 3 per pixel */
+    uint16_t *rowOut;   /* one output row, or the whole output if interlaced */
+    uint8_t pixel[4];   /* 8 bit samples of the current pixel */
+    int rowAborted;
 } PngInfoStruct;
 
 /* helper macro to output warning via user context of the info struct */
@@ -277,6 +290,22 @@ static void internalFree(void *ptr, void *userPtr)
     free(ptr);
 }
 
+#ifndef LUPNG_USE_ZLIB
+static void *internalZalloc(void *opaque, size_t items, size_t size)
+#else
+static voidpf internalZalloc(voidpf opaque, uInt items, uInt size)
+#endif
+{
+    const LuUserContext *userCtx = (const LuUserContext *)opaque;
+    return userCtx->allocProc(items * size, userCtx->allocProcUserPtr);
+}
+
+static void internalZfree(void *opaque, void *ptr)
+{
+    const LuUserContext *userCtx = (const LuUserContext *)opaque;
+    userCtx->freeProc(ptr, userCtx->freeProcUserPtr);
+}
+
 static void internalPrintf(void *userPtr, const char *fmt, ...)
 {
     FILE *outStream = (FILE*)userPtr;
@@ -395,11 +424,111 @@ static LU_INLINE uint8_t paeth(PngInfoStruct *info)
 
 
 
+/********************************************************
+ * Row mode output
+ ********************************************************/
+static LU_INLINE uint16_t toRgb565(uint32_t r, uint32_t g, uint32_t b)
+{
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+static int allocRows(PngInfoStruct *info)
+{
+    uint32_t scaleX = info->rowMaxWidth ? (info->width + info->rowMaxWidth - 1) / info->rowMaxWidth : 1;
+    uint32_t scaleY = info->rowMaxHeight ? (info->height + info->rowMaxHeight - 1) / info->rowMaxHeight : 1;
+    size_t outSize;
+
+    info->rowScale = MAX(MAX(scaleX, scaleY), 1);
+    info->rowWidth = MAX(info->width / info->rowScale, 1);
+    info->rowHeight = MAX(info->height / info->rowScale, 1);
+
+    /* rows of interlaced images only complete on the last pass, the whole
+     * output is kept and sampled instead of filtered */
+    outSize = info->interlace ? info->rowWidth * info->rowHeight : info->rowWidth;
+    info->rowOut = (uint16_t *)info->userCtx->allocProc(outSize * 2, info->userCtx->allocProcUserPtr);
+    if (!info->rowOut)
+        return 0;
+    memset(info->rowOut, 0, outSize * 2);
+
+    if (!info->interlace && info->rowScale > 1)
+    {
+        info->rowSums = (uint32_t *)info->userCtx->allocProc(info->rowWidth * 3 * sizeof(uint32_t),
+                                                             info->userCtx->allocProcUserPtr);
+        if (!info->rowSums)
+            return 0;
+        memset(info->rowSums, 0, info->rowWidth * 3 * sizeof(uint32_t));
+    }
+
+    return 1;
+}
+
+/* called once all samples of the pixel at currentCol/currentRow are in */
+static LU_INLINE void rowPixel(PngInfoStruct *info)
+{
+    int32_t x, y;
+    uint8_t r = info->pixel[0], g = info->pixel[1], b = info->pixel[2];
+
+    if (info->channels < 3 && info->colorType != PNG_PALETTED)
+        g = b = r;
+
+    if (info->rowScale == 1 && !info->interlace)
+    {
+        info->rowOut[info->currentCol] = toRgb565(r, g, b);
+        return;
+    }
+
+    x = info->currentCol / info->rowScale;
+    y = info->currentRow / info->rowScale;
+
+    if (x >= info->rowWidth || y >= info->rowHeight)
+        return;
+
+    if (info->rowSums)
+    {
+        uint32_t *sums = info->rowSums + x * 3;
+        sums[0] += r;
+        sums[1] += g;
+        sums[2] += b;
+    }
+    else if (info->currentCol % info->rowScale == 0 && info->currentRow % info->rowScale == 0)
+    {
+        info->rowOut[(info->interlace ? y * info->rowWidth : 0) + x] = toRgb565(r, g, b);
+    }
+}
+
+/* called at the end of each scanline of non interlaced images */
+static LU_INLINE void rowEnd(PngInfoStruct *info)
+{
+    int32_t y = info->currentRow / info->rowScale;
+    uint32_t area = info->rowScale * info->rowScale;
+    int32_t x;
+
+    if ((info->currentRow + 1) % info->rowScale != 0 || y >= info->rowHeight)
+        return;
+
+    if (info->rowSums)
+    {
+        for (x = 0; x < info->rowWidth; ++x)
+        {
+            uint32_t *sums = info->rowSums + x * 3;
+            info->rowOut[x] = toRgb565(sums[0] / area, sums[1] / area, sums[2] / area);
+        }
+        memset(info->rowSums, 0, info->rowWidth * 3 * sizeof(uint32_t));
+    }
+
+    if (info->rowProc(info->rowOut, y, info->rowWidth, info->rowHeight, info->rowProcUserPtr))
+        info->rowAborted = 1;
+}
+
+
+
 /********************************************************
  * Actual implementation
  ********************************************************/
 static LU_INLINE int parseIhdr(PngInfoStruct *info, PngChunk *chunk)
 {
+    int samples;
+
     if (info->chunksFound)
     {
         LUPNG_WARN(info,"PNG: malformed PNG file!");
@@ -469,21 +598,42 @@ static LU_INLINE int parseIhdr(PngInfoStruct *info, PngChunk *chunk)
     }
 
     memset(&(info->stream), 0, sizeof(info->stream));
+    info->stream.zalloc = internalZalloc;
+    info->stream.zfree = internalZfree;
+    info->stream.opaque = (void *)info->userCtx;
     if(inflateInit(&(info->stream)) != Z_OK)
     {
         LUPNG_WARN(info, "PNG: inflateInit failed!");
         return PNG_ERROR;
     }
-    info->img = luImageCreate(info->width, info->height,
-                              info->channels, info->depth < 16 ? 8 : 16, NULL, info->userCtx);
-    info->cimg = info->img;
-    info->scanlineBytes = MAX((info->width * info->channels * info->depth) >> 3, 1);
+    if (info->rowProc)
+    {
+        if (!allocRows(info))
+        {
+            LUPNG_WARN(info, "PNG: memory allocation failed!");
+            return PNG_ERROR;
+        }
+    }
+    else
+    {
+        info->img = luImageCreate(info->width, info->height,
+                                  info->channels, info->depth < 16 ? 8 : 16, NULL, info->userCtx);
+        info->cimg = info->img;
+        if (!info->img)
+        {
+            LUPNG_WARN(info, "PNG: memory allocation failed!");
+            return PNG_ERROR;
+        }
+    }
+    /* paletted images are filtered as one index per pixel */
+    samples = info->colorType == PNG_PALETTED ? 1 : info->channels;
+    info->scanlineBytes = MAX((info->width * samples * info->depth) >> 3, 1);
     info->currentScanline = (uint8_t *)info->userCtx->allocProc(info->scanlineBytes, info->userCtx->allocProcUserPtr);
     info->previousScanline = (uint8_t *)info->userCtx->allocProc(info->scanlineBytes, info->userCtx->allocProcUserPtr);
     info->currentCol = -1;
     info->interlacePass = info->interlace ? 1 : 0;
-    info->bytesPerPixel = MAX((info->channels * info->depth) >> 3, 1);
-    if (!info->img || !info->currentScanline || !info->previousScanline)
+    info->bytesPerPixel = MAX((samples * info->depth) >> 3, 1);
+    if (!info->currentScanline || !info->previousScanline)
     {
         LUPNG_WARN(info, "PNG: memory allocation failed!");
         return PNG_ERROR;
@@ -570,7 +720,26 @@ static LU_INLINE int insertByte(PngInfoStruct *info, uint8_t byte)
 
     if (info->colorType != PNG_PALETTED)
     {
-        if (info->depth == 8)
+        if (info->rowProc)
+        {
+            if (info->depth == 8)
+                info->pixel[info->currentElem] = byte;
+
+            else if (info->depth < 8)
+                info->pixel[info->currentElem] = byte * scale[info->depth];
+
+            else if (info->tmpCount) /* 2nd byte of a 16 bit sample */
+                info->tmpCount = 0;
+
+            else
+            {
+                info->pixel[info->currentElem] = byte;
+                ++info->tmpCount;
+                return 0;
+            }
+        }
+
+        else if (info->depth == 8)
             info->cimg->data[idx] = byte;
 
         else if (info->depth < 8)
@@ -604,7 +773,13 @@ static LU_INLINE int insertByte(PngInfoStruct *info, uint8_t byte)
     else
     {
         /* The spec limits palette size to 256 entries */
-        if (byte < info->paletteItems)
+        if (byte < info->paletteItems && info->rowProc)
+        {
+            info->pixel[0] = info->palette[3*byte  ];
+            info->pixel[1] = info->palette[3*byte+1];
+            info->pixel[2] = info->palette[3*byte+2];
+        }
+        else if (byte < info->paletteItems)
         {
             info->cimg->data[idx  ] = info->palette[3*byte  ];
             info->cimg->data[idx+1] = info->palette[3*byte+1];
@@ -619,11 +794,17 @@ static LU_INLINE int insertByte(PngInfoStruct *info, uint8_t byte)
 
     if (advance)
     {
+        if (info->rowProc)
+            rowPixel(info);
+
         /* advance to next pixel */
         info->currentCol += colIncrement[info->interlacePass];
 
         if (info->currentCol >= info->width)
         {
+            if (info->rowProc && !info->interlace)
+                rowEnd(info);
+
             uint8_t *tmp = info->currentScanline;
             info->currentScanline = info->previousScanline;
             info->previousScanline = tmp;
@@ -735,6 +916,9 @@ static LU_INLINE int parseIdat(PngInfoStruct *info, PngChunk *chunk)
                     insertByte(info, rawByte);
             }
         }
+
+        if (info->rowAborted)
+            return PNG_ERROR;
     } while ((info->stream.avail_in > 0 || info->stream.avail_out == 0)
             && info->currentCol < info->width && info->currentRow < info->height);
 
@@ -827,43 +1011,48 @@ static LU_INLINE int handleChunk(PngInfoStruct *info, PngChunk *chunk)
     return PNG_OK;
 }
 
-LuImage *luPngReadUC(const LuUserContext *userCtx)
+static int readPng(PngInfoStruct *info)
 {
-
+    const LuUserContext *userCtx = info->userCtx;
     uint8_t signature[PNG_SIG_SIZE];
     int status = PNG_ERROR;
 
-    PngInfoStruct info;
-    memset(&info, 0, sizeof(PngInfoStruct));
-    info.userCtx = userCtx;
-
     if (!userCtx->skipSig)
     {
-        info.userCtx->readProc((void *)signature, 1, PNG_SIG_SIZE, info.userCtx->readProcUserPtr);
+        userCtx->readProc((void *)signature, 1, PNG_SIG_SIZE, userCtx->readProcUserPtr);
         status = bytesEqual(signature, PNG_SIG, PNG_SIG_SIZE) ? PNG_OK : PNG_ERROR;
     }
 
     if (status == PNG_OK)
     {
         PngChunk *chunk;
-        while ((chunk = readChunk(&info)))
+        while ((chunk = readChunk(info)))
         {
-            status = handleChunk(&info, chunk);
-            releaseChunk(chunk, info.userCtx);
+            status = handleChunk(info, chunk);
+            releaseChunk(chunk, userCtx);
 
             if (status != PNG_OK)
                 break;
         }
     }
     else
-        LUPNG_WARN(&info, "PNG: invalid header");
+        LUPNG_WARN(info, "PNG: invalid header");
+
+    userCtx->freeProc(info->currentScanline, userCtx->freeProcUserPtr);
+    userCtx->freeProc(info->previousScanline, userCtx->freeProcUserPtr);
+    userCtx->freeProc(info->palette, userCtx->freeProcUserPtr);
+    inflateEnd(&info->stream);
 
-    userCtx->freeProc(info.currentScanline, userCtx->freeProcUserPtr);
-    userCtx->freeProc(info.previousScanline, userCtx->freeProcUserPtr);
-    userCtx->freeProc(info.palette, userCtx->freeProcUserPtr);
-    inflateEnd(&info.stream);
+    return status;
+}
+
+LuImage *luPngReadUC(const LuUserContext *userCtx)
+{
+    PngInfoStruct info;
+    memset(&info, 0, sizeof(PngInfoStruct));
+    info.userCtx = userCtx;
 
-    if (status == PNG_DONE)
+    if (readPng(&info) == PNG_DONE)
         return info.img;
     else
         if (info.img)
@@ -872,6 +1061,37 @@ LuImage *luPngReadUC(const LuUserContext *userCtx)
     return NULL;
 }
 
+int luPngReadRows(const LuUserContext *userCtx, uint32_t maxWidth, uint32_t maxHeight,
+                  PngRowProc rowProc, void *rowProcUserPtr)
+{
+    int status;
+    int32_t y;
+
+    PngInfoStruct info;
+    memset(&info, 0, sizeof(PngInfoStruct));
+    info.userCtx = userCtx;
+    info.rowProc = rowProc;
+    info.rowProcUserPtr = rowProcUserPtr;
+    info.rowMaxWidth = maxWidth;
+    info.rowMaxHeight = maxHeight;
+
+    status = readPng(&info);
+
+    if (status == PNG_DONE && info.interlace)
+    {
+        for (y = 0; y < info.rowHeight; ++y)
+        {
+            if (rowProc(info.rowOut + y * info.rowWidth, y, info.rowWidth, info.rowHeight, rowProcUserPtr))
+                break;
+        }
+    }
+
+    userCtx->freeProc(info.rowSums, userCtx->freeProcUserPtr);
+    userCtx->freeProc(info.rowOut, userCtx->freeProcUserPtr);
+
+    return status == PNG_DONE ? PNG_OK : PNG_ERROR;
+}
+
 LuImage *luPngRead(PngReadProc readProc, void *userPtr, int skipSig)
 {
     LuUserContext userCtx;
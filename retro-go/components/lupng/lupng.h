@@ -54,6 +54,8 @@ typedef size_t (*PngWriteProc)(const void *inPtr, size_t size, size_t count, voi
 typedef void*  (*PngAllocProc)(size_t size, void *userPtr);
 typedef void   (*PngFreeProc)(void *ptr, void *userPtr);
 typedef void   (*PngWarnProc)(void *userPtr, const char *fmt, ...);
+/* returns non-zero to stop decoding */
+typedef int    (*PngRowProc)(const uint16_t *row, int32_t y, int32_t width, int32_t height, void *userPtr);
 
 typedef struct {
     /* loader */
@@ -149,6 +151,25 @@ LuImage *luPngRead(PngReadProc readProc, void *userPtr, int skipSig);
  */
 LuImage *luPngReadUC(const LuUserContext *userCtx);
 
+/**
+ * Decodes a PNG image one row at a time, without keeping more than two
+ * scanlines of it in memory. Rows are converted to RGB565 (alpha is ignored)
+ * and handed to rowProc from top to bottom. Images larger than maxWidth x
+ * maxHeight are scaled down by an integer factor, averaging each block of
+ * pixels (interlaced images are sampled instead and need the whole output
+ * in memory).
+ *
+ * @param userCtx the LuUserContext to use
+ * @param maxWidth the largest output width, or 0 for any
+ * @param maxHeight the largest output height, or 0 for any
+ * @param rowProc called for every output row, width and height are those of
+ * the output
+ * @param rowProcUserPtr an opaque pointer provided as an argument to rowProc
+ * @return 0 on success, -1 on failure or if rowProc stopped decoding
+ */
+int luPngReadRows(const LuUserContext *userCtx, uint32_t maxWidth, uint32_t maxHeight,
+                  PngRowProc rowProc, void *rowProcUserPtr);
+
 /**
  * Encodes a LuImage struct to PNG and writes it out to a file.
  *
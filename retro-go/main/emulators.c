@@ -6,13 +6,37 @@
 #include "emulators.h"
 #include "gui.h"
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
 #include <esp_partition.h>
 #include <esp_system.h>
+#include <rom/crc.h>
 #include <sys/stat.h>
+#include <sys/param.h>
 #include <string.h>
 #include <dirent.h>
 #include <unistd.h>
 
+#define ROM_INDEX_MAGIC 0x58444952 // "RIDX"
+#define ROM_SCAN_BATCH  32
+
+// Index file of a system's roms, the file names follow the header, sorted and
+// NUL terminated
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t signature;
+    uint32_t size; // Of the names
+} rom_index_header_t;
+
+static struct {
+    QueueHandle_t queue;
+    retro_emulator_t *emu;
+    retro_emulator_roms_t list;
+    volatile bool ready;
+} rescan;
+
 retro_emulators_t emulators_stack;
 retro_emulators_t *emulators = &emulators_stack;
 
@@ -34,6 +58,9 @@ static void add_emulator(const char *system, const char *dirname, const char* ex
     p->roms.selected = 0;
     p->roms.count = 0;
     p->roms.files = NULL;
+    p->roms.names = NULL;
+    p->roms.names_size = 0;
+    p->roms.signature = 0;
     p->image_logo = (uint16_t *)logo;
     p->image_header = (uint16_t *)header;
     p->initialized = false;
@@ -42,78 +69,346 @@ static void add_emulator(const char *system, const char *dirname, const char* ex
 
 static int file_sort_comparator(const void *p, const void *q)
 {
-    retro_emulator_file_t *l = (retro_emulator_file_t*)p;
-    retro_emulator_file_t *r = (retro_emulator_file_t*)q;
-    return strcmp(l->name, r->name);
+    return strcmp(*(const char**)p, *(const char**)q);
 }
 
-void emulators_init_emu(retro_emulator_t *emu)
+// Sorts by name through an array of pointers to the names, the checksums
+// aren't known yet at this point
+static void sort_files(retro_emulator_roms_t *list)
 {
-    if (emu->initialized)
+    const char **order = malloc(list->count * sizeof(char*));
+
+    if (!order)
     {
+        printf("sort_files: Not enough memory, list left unsorted\n");
         return;
     }
 
-    printf("emulators_init_emu: Initializing %s\n", emu->system_name);
+    for (int i = 0; i < list->count; i++)
+    {
+        order[i] = list->names + list->files[i].name;
+    }
 
-    emu->initialized = true;
+    qsort((void*)order, list->count, sizeof(char*), file_sort_comparator);
 
-    char path[128];
+    for (int i = 0; i < list->count; i++)
+    {
+        list->files[i].name = order[i] - list->names;
+    }
 
-    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+    free(order);
+}
 
-    sprintf(path, ODROID_BASE_PATH_CRC_CACHE "/%s", emu->dirname);
-    odroid_sdcard_mkdir(path);
+static void free_files(retro_emulator_roms_t *list)
+{
+    free(list->files);
+    free(list->names);
+    list->files = NULL;
+    list->names = NULL;
+    list->names_size = 0;
+    list->count = 0;
+}
 
-    sprintf(path, ODROID_BASE_PATH_SAVES "/%s", emu->dirname);
-    odroid_sdcard_mkdir(path);
+static size_t files_memory(retro_emulator_roms_t *list)
+{
+    return list->count * sizeof(retro_emulator_file_t) + list->names_size;
+}
+
+static bool add_file(retro_emulator_roms_t *list, size_t *names_capacity, const char *filename, const char *ext)
+{
+    size_t len = strlen(filename) + 1;
+
+    if (list->count % 100 == 0) {
+        void *files = realloc(list->files, (list->count + 100) * sizeof(retro_emulator_file_t));
+        if (!files) return false;
+        list->files = files;
+    }
+
+    if (list->names_size + len > *names_capacity) {
+        size_t capacity = MAX(*names_capacity * 2, 4096);
+        void *names = realloc(list->names, capacity);
+        if (!names) return false;
+        list->names = names;
+        *names_capacity = capacity;
+    }
+
+    // The extension's dot becomes the name's terminator
+    char *name = list->names + list->names_size;
+    memcpy(name, filename, len);
+    name[ext - filename - 1] = 0;
+
+    list->files[list->count].name = list->names_size;
+    list->files[list->count].checksum = 0;
+    list->count++;
+    list->names_size += len;
+
+    return true;
+}
+
+static void select_file(retro_emulator_t *emu, const char *path)
+{
+    char dir[64];
+    size_t dir_len = sprintf(dir, ODROID_BASE_PATH_ROMS "/%s/", emu->dirname);
+
+    if (strncmp(path, dir, dir_len) != 0) {
+        return;
+    }
+
+    const char *filename = path + dir_len;
+
+    for (int i = 0; i < emu->roms.count; i++) {
+        const char *name = emulators_file_name(emu, &emu->roms.files[i]);
+        size_t len = strlen(name);
+        if (strncmp(filename, name, len) == 0 && filename[len] == '.' && strcmp(filename + len + 1, name + len + 1) == 0) {
+            emu->roms.selected = i;
+            break;
+        }
+    }
+}
+
+// Lists the roms in emu's directory. The signature is a crc32 of the names in
+// directory order, it changes whenever a file is added, removed or renamed.
+// The sd card is released every few entries so that the display can be used.
+static void scan_dir(retro_emulator_t *emu, retro_emulator_roms_t *list)
+{
+    size_t names_capacity = 0;
+    uint32_t crc = 0;
+    char path[128];
 
     sprintf(path, ODROID_BASE_PATH_ROMS "/%s", emu->dirname);
-    odroid_sdcard_mkdir(path);
+
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
 
     DIR* dir = opendir(path);
     if (dir)
     {
         struct dirent* in_file;
 
-        while ((in_file = readdir(dir)))
+        for (int n = 1; (in_file = readdir(dir)); n++)
         {
-            char *ext = odroid_sdcard_get_extension(in_file->d_name);
+            const char *ext = odroid_sdcard_get_extension(in_file->d_name);
+
+            if (n % ROM_SCAN_BATCH == 0)
+            {
+                odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+                odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+            }
 
             if (!ext) continue;
 
             if (strcasecmp(emu->ext, ext) != 0 && strcasecmp("zip", ext) != 0)
                 continue;
 
-            if (emu->roms.count % 100 == 0) {
-                emu->roms.files = (retro_emulator_file_t *)realloc(emu->roms.files,
-                    (emu->roms.count + 100) * sizeof(retro_emulator_file_t));
+            if (!add_file(list, &names_capacity, in_file->d_name, ext))
+            {
+                printf("scan_dir: Not enough memory, stopped at %d files\n", list->count);
+                break;
             }
-            retro_emulator_file_t *file = &emu->roms.files[emu->roms.count++];
-            sprintf(file->path, "%s/%s", path, in_file->d_name);
-            strcpy(file->name, in_file->d_name);
-            strcpy(file->ext, ext);
-            file->name[strlen(file->name)-strlen(ext)-1] = 0;
-            file->checksum = 0;
+
+            crc = crc32_le(crc, (const uint8_t*)in_file->d_name, strlen(in_file->d_name) + 1);
         }
 
         closedir(dir);
     }
 
-    if (emu->roms.count > 0)
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+    if (list->names_size > 0)
+    {
+        list->names = realloc(list->names, list->names_size);
+    }
+
+    list->signature = crc;
+}
+
+static bool load_index(retro_emulator_t *emu, retro_emulator_roms_t *list)
+{
+    rom_index_header_t header = {0};
+    char path[128];
+    bool ret = false;
+
+    sprintf(path, ODROID_BASE_PATH_ROM_INDEX "/%s.idx", emu->dirname);
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        return false;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) == 1 && header.magic == ROM_INDEX_MAGIC && header.count == 0)
+    {
+        list->signature = header.signature;
+        ret = true;
+    }
+    else if (header.magic == ROM_INDEX_MAGIC && header.size > 0)
+    {
+        // The names are read in one go and used in place, only the dots that
+        // start the extensions are replaced
+        list->names = malloc(header.size);
+        list->files = malloc(header.count * sizeof(retro_emulator_file_t));
+
+        if (list->names && list->files && fread(list->names, header.size, 1, fp) == 1 && list->names[header.size - 1] == 0)
+        {
+            list->names_size = header.size;
+
+            char *name = list->names, *ext;
+            while (list->count < header.count && name < list->names + header.size
+                && (ext = (char *)odroid_sdcard_get_extension(name)))
+            {
+                ext[-1] = 0;
+                list->files[list->count].name = name - list->names;
+                list->files[list->count].checksum = 0;
+                list->count++;
+                name = ext + strlen(ext) + 1;
+            }
+
+            list->signature = header.signature;
+            ret = list->count == header.count;
+        }
+    }
+
+    fclose(fp);
+
+    if (!ret)
+    {
+        printf("load_index: Invalid index for %s\n", emu->dirname);
+        free_files(list);
+    }
+
+    return ret;
+}
+
+static void save_index(retro_emulator_t *emu, retro_emulator_roms_t *list)
+{
+    rom_index_header_t header = {ROM_INDEX_MAGIC, list->count, list->signature, 0};
+    char path[128];
+
+    sprintf(path, ODROID_BASE_PATH_ROM_INDEX "/%s.idx", emu->dirname);
+
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+
+    FILE *fp = odroid_sdcard_fopen(path, "wb");
+    if (fp)
+    {
+        // Same size as the names in memory, the terminators become dots again
+        header.size = list->names_size;
+        fwrite(&header, sizeof(header), 1, fp);
+        for (int i = 0; i < list->count; i++)
+        {
+            const char *name = list->names + list->files[i].name;
+            const char *ext = name + strlen(name) + 1;
+            fprintf(fp, "%s.%s", name, ext);
+            fputc(0, fp);
+        }
+        fclose(fp);
+    }
+
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+}
+
+// Checks the directories of the systems that were loaded from their index,
+// the list is rebuilt if anything changed since it was saved
+static void rescan_task(void *arg)
+{
+    retro_emulator_t *emu;
+
+    while (1)
     {
-        qsort((void*)emu->roms.files, emu->roms.count, sizeof(retro_emulator_file_t), file_sort_comparator);
+        xQueueReceive(rescan.queue, &emu, portMAX_DELAY);
+
+        retro_emulator_roms_t list = {0};
+        uint32_t start_time = xTaskGetTickCount();
 
+        scan_dir(emu, &list);
+
+        printf("rescan_task: %s: %d files scanned in %dms\n", emu->dirname, list.count,
+            (xTaskGetTickCount() - start_time) * portTICK_PERIOD_MS);
+
+        if (list.count == emu->roms.count && list.signature == emu->roms.signature)
+        {
+            free_files(&list);
+            continue;
+        }
+
+        sort_files(&list);
+        save_index(emu, &list);
+
+        // Handed over to the main task in emulators_refresh
+        while (rescan.ready)
+        {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+
+        rescan.emu = emu;
+        rescan.list = list;
+        rescan.ready = true;
+    }
+}
+
+void emulators_init_emu(retro_emulator_t *emu)
+{
+    if (emu->initialized)
+    {
+        return;
+    }
+
+    printf("emulators_init_emu: Initializing %s\n", emu->system_name);
+
+    emu->initialized = true;
+
+    uint32_t start_time = xTaskGetTickCount();
+    char path[128];
+
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+
+    sprintf(path, ODROID_BASE_PATH_CRC_CACHE "/%s", emu->dirname);
+    odroid_sdcard_mkdir(path);
+
+    sprintf(path, ODROID_BASE_PATH_COVER_CACHE "/%s", emu->dirname);
+    odroid_sdcard_mkdir(path);
+
+    sprintf(path, ODROID_BASE_PATH_SAVES "/%s", emu->dirname);
+    odroid_sdcard_mkdir(path);
+
+    sprintf(path, ODROID_BASE_PATH_ROMS "/%s", emu->dirname);
+    odroid_sdcard_mkdir(path);
+
+    odroid_sdcard_mkdir(ODROID_BASE_PATH_ROM_INDEX);
+
+    bool indexed = load_index(emu, &emu->roms);
+
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+
+    if (indexed)
+    {
+        // FAT doesn't update directory timestamps, only a rescan can tell if
+        // the index is stale. It happens in the background, the list is
+        // replaced if needed.
+        if (!rescan.queue)
+        {
+            rescan.queue = xQueueCreate(16, sizeof(retro_emulator_t *));
+            xTaskCreatePinnedToCore(&rescan_task, "rescan_task", 4096, NULL, 1, NULL, 0);
+        }
+        xQueueSend(rescan.queue, &emu, 0);
+    }
+    else
+    {
+        scan_dir(emu, &emu->roms);
+        sort_files(&emu->roms);
+        save_index(emu, &emu->roms);
+    }
+
+    printf("emulators_init_emu: %d files %s in %dms, using %d bytes\n", emu->roms.count,
+        indexed ? "loaded" : "scanned", (xTaskGetTickCount() - start_time) * portTICK_PERIOD_MS,
+        files_memory(&emu->roms));
+
+    if (emu->roms.count > 0)
+    {
         char *selected_file = odroid_settings_RomFilePath_get();
         if (selected_file) {
             if (strlen(selected_file) > strlen(emu->ext)+1 &&
                 strcasecmp(emu->ext, &selected_file[strlen(selected_file)-strlen(emu->ext)]) == 0) {
-                for (int i = 0;i < emu->roms.count; i++) {
-                    if (strcmp(emu->roms.files[i].path, selected_file) == 0) {
-                        emu->roms.selected = i;
-                        break;
-                    }
-                }
+                select_file(emu, selected_file);
             }
             free(selected_file);
         }
@@ -122,8 +417,65 @@ void emulators_init_emu(retro_emulator_t *emu)
     if (emu->roms.selected > emu->roms.count - 1) {
         emu->roms.selected = 0;
     }
+}
 
-    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+// Swaps in a list rebuilt by rescan_task, returns the emulator it belongs to
+retro_emulator_t *emulators_refresh()
+{
+    if (!rescan.ready)
+    {
+        return NULL;
+    }
+
+    retro_emulator_t *emu = rescan.emu;
+    char *selected = NULL;
+
+    if (emu->roms.selected < emu->roms.count) {
+        selected = emulators_file_path(emu, &emu->roms.files[emu->roms.selected]);
+    }
+
+    free_files(&emu->roms);
+    emu->roms.files = rescan.list.files;
+    emu->roms.names = rescan.list.names;
+    emu->roms.names_size = rescan.list.names_size;
+    emu->roms.count = rescan.list.count;
+    emu->roms.signature = rescan.list.signature;
+    emu->roms.selected = 0;
+
+    if (selected) {
+        select_file(emu, selected);
+        free(selected);
+    }
+
+    rescan.ready = false;
+
+    printf("emulators_refresh: %s: %d files, using %d bytes\n", emu->dirname, emu->roms.count,
+        files_memory(&emu->roms));
+
+    return emu;
+}
+
+const char *emulators_file_name(retro_emulator_t *emu, const retro_emulator_file_t *file)
+{
+    return emu->roms.names + file->name;
+}
+
+const char *emulators_file_ext(retro_emulator_t *emu, const retro_emulator_file_t *file)
+{
+    const char *name = emu->roms.names + file->name;
+    return name + strlen(name) + 1;
+}
+
+// The returned path must be freed by the caller
+char *emulators_file_path(retro_emulator_t *emu, const retro_emulator_file_t *file)
+{
+    const char *name = emulators_file_name(emu, file);
+    const char *ext = emulators_file_ext(emu, file);
+    char *path = malloc(strlen(ODROID_BASE_PATH_ROMS) + strlen(emu->dirname) + strlen(name) + strlen(ext) + 4);
+
+    sprintf(path, ODROID_BASE_PATH_ROMS "/%s/%s.%s", emu->dirname, name, ext);
+
+    return path;
 }
 
 void emulators_init()
@@ -141,9 +493,10 @@ void emulators_init()
 
 void emulators_start_emu(retro_emulator_t *emu)
 {
-    const retro_emulator_file_t *file = gui_list_selected_file(emu);
-    printf("Starting game: %s\n", file->path);
+    char *path = emulators_file_path(emu, gui_list_selected_file(emu));
+    printf("Starting game: %s\n", path);
 
-    odroid_settings_RomFilePath_set(file->path);
+    odroid_settings_RomFilePath_set(path);
+    free(path);
     odroid_system_switch_app(emu->partition);
 }
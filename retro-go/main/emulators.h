@@ -5,12 +5,19 @@
 #include <stdbool.h>
 
 typedef struct {
-    char name[96];
-    char ext[8];
-    char path[128];
+    uint32_t name; // Offset in the list's names, see emulators_file_name
     uint32_t checksum;
 } retro_emulator_file_t;
 
+typedef struct {
+    retro_emulator_file_t *files;
+    char *names;        // Each file's name then extension, NUL terminated
+    size_t names_size;
+    int selected;
+    int count;
+    uint32_t signature; // Of the directory listing the files came from
+} retro_emulator_roms_t;
+
 typedef struct {
     char system_name[64];
     char dirname[32];
@@ -19,11 +26,7 @@ typedef struct {
     uint16_t partition;
     uint16_t* image_logo;
     uint16_t* image_header;
-    struct {
-        retro_emulator_file_t *files;
-        int selected;
-        int count;
-    } roms;
+    retro_emulator_roms_t roms;
     bool initialized;
 } retro_emulator_t;
 
@@ -35,5 +38,9 @@ typedef struct {
 void emulators_init();
 void emulators_init_emu(retro_emulator_t *emu);
 void emulators_start_emu(retro_emulator_t *emu);
+retro_emulator_t *emulators_refresh();
+const char *emulators_file_name(retro_emulator_t *emu, const retro_emulator_file_t *file);
+const char *emulators_file_ext(retro_emulator_t *emu, const retro_emulator_file_t *file);
+char *emulators_file_path(retro_emulator_t *emu, const retro_emulator_file_t *file);
 
 extern retro_emulators_t *emulators;
@@ -1,4 +1,10 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <rom/crc.h>
+#include <sys/param.h>
+#include <sys/stat.h>
 #include <stdio.h>
 #include <string.h>
 #include <dirent.h>
@@ -25,6 +31,12 @@
 #define LIST_X_OFFSET    (0)
 #define LIST_Y_OFFSET    (48 + LIST_LINE_HEIGHT)
 
+#define COVER_CACHE_SIZE (6)
+#define COVER_NEIGHBORS  (2)     // Prefetched on each side of the selection
+#define COVER_SLICE_SIZE (16384) // Longest sd card read done while holding the spi lock
+#define COVER_MAX_SIZE   (200)   // Larger PNG art is scaled down to fit
+#define COVER_THUMB_MAGIC 0x35363552 // "R565"
+
 typedef struct  {
     uint16_t list_background;
     uint16_t list_foreground;
@@ -50,8 +62,56 @@ theme_t gui_themes[] = {
 };
 int gui_themes_count = 12;
 
-
-static uint16_t *cover_buffer;
+// A cover ready to be drawn, data is NULL if the rom has none
+typedef struct {
+    uint32_t key;      // crc32 of the rom's path
+    uint32_t checksum; // Of the rom, 1 if it couldn't be read
+    uint32_t used;
+    uint16_t width;
+    uint16_t height;
+    uint16_t *data;    // RGB565
+} cover_t;
+
+// A decoded PNG cover saved in the cover cache, the pixels follow the header
+typedef struct {
+    uint32_t magic;
+    uint16_t width;
+    uint16_t height;
+    uint32_t mtime; // Of the PNG it was made from
+} cover_thumb_header_t;
+
+typedef struct {
+    retro_emulator_t *emu;
+    int count;
+    struct {
+        uint32_t key;
+        uint32_t checksum;
+        char path[256];
+    } files[1 + COVER_NEIGHBORS * 2];
+} cover_request_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} cover_reader_t;
+
+static struct {
+    QueueHandle_t queue;
+    SemaphoreHandle_t lock; // Of the cache, also held by the main task while it draws
+    cover_t cache[COVER_CACHE_SIZE];
+    uint32_t ticks;
+    // CRC progress kept when a newer request interrupts it
+    struct {
+        uint32_t key;
+        uint32_t crc;
+        long offset;
+    } partial;
+    uint8_t *buffer;
+    // Used by the main task only
+    bool shown;
+    uint selected_time;
+} covers;
 
 
 const retro_emulator_file_t *gui_list_selected_file(retro_emulator_t *emu)
@@ -73,19 +133,19 @@ bool gui_list_handle_input(retro_emulator_t *emu, odroid_gamepad_state *joystick
         selected++;
     } else if (joystick->values[ODROID_INPUT_LEFT]) {
         *last_key = ODROID_INPUT_LEFT;
-        char st = ((char*)emu->roms.files[selected].name)[0];
+        char st = emulators_file_name(emu, &emu->roms.files[selected])[0];
         int max = LIST_LINE_COUNT - 2;
         while (--selected > 0 && max-- > 0)
         {
-           if (st != ((char*)emu->roms.files[selected].name)[0]) break;
+           if (st != emulators_file_name(emu, &emu->roms.files[selected])[0]) break;
         }
     } else if (joystick->values[ODROID_INPUT_RIGHT]) {
         *last_key = ODROID_INPUT_RIGHT;
-        char st = ((char*)emu->roms.files[selected].name)[0];
+        char st = emulators_file_name(emu, &emu->roms.files[selected])[0];
         int max = LIST_LINE_COUNT - 2;
         while (++selected < emu->roms.count-1 && max-- > 0)
         {
-           if (st != ((char*)emu->roms.files[selected].name)[0]) break;
+           if (st != emulators_file_name(emu, &emu->roms.files[selected])[0]) break;
         }
     }
 
@@ -118,130 +178,503 @@ void gui_list_draw(retro_emulator_t *emu, int theme_)
     float gradient = 16.f / lines;
     theme_t theme = gui_themes[theme_ % gui_themes_count];
 
+    if (covers.lock) {
+        xSemaphoreTake(covers.lock, portMAX_DELAY);
+    }
+
     odroid_overlay_draw_text(CRC_X_OFFSET, CRC_Y_OFFSET, CRC_WIDTH, (char*)" ", C_RED, C_BLACK);
+    covers.shown = false;
 
     for (int i = 0; i < lines; i++) {
         int entry = emu->roms.selected + i - (lines / 2);
         int y = LIST_Y_OFFSET + i * LIST_LINE_HEIGHT;
-        char *text = (entry >= 0 && entry < emu->roms.count) ? emu->roms.files[entry].name : (char *)" ";
+        char *text = (entry >= 0 && entry < emu->roms.count) ? (char *)emulators_file_name(emu, &emu->roms.files[entry]) : (char *)" ";
         uint16_t fg_color = (entry == emu->roms.selected) ? theme.list_highlight : theme.list_foreground;
         odroid_overlay_draw_text(LIST_X_OFFSET, y, LIST_WIDTH, text, fg_color, (int)(gradient * i) << theme.list_background);
     }
+
+    if (covers.lock) {
+        xSemaphoreGive(covers.lock);
+    }
 }
 
-// This should be in a FreeRTOS task
-// But the problem is that the main task can't draw while this task accesses the SD Card or draws
-// So it's kind of pointless. The solution would be preloading I think.
-void gui_cover_draw(retro_emulator_t *emu, odroid_gamepad_state *joystick)
+// Returns the cached cover matching key, the caller must hold covers.lock
+static cover_t *cover_find(uint32_t key)
 {
-    if (emu->roms.count == 0 || emu->roms.selected > emu->roms.count) {
-        return;
+    for (int i = 0; i < COVER_CACHE_SIZE; i++)
+    {
+        if (covers.cache[i].key == key)
+        {
+            covers.cache[i].used = ++covers.ticks;
+            return &covers.cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void cover_insert(const cover_t *cover)
+{
+    xSemaphoreTake(covers.lock, portMAX_DELAY);
+
+    cover_t *victim = &covers.cache[0];
+    for (int i = 1; i < COVER_CACHE_SIZE; i++)
+    {
+        if (covers.cache[i].used < victim->used)
+            victim = &covers.cache[i];
     }
 
-    if (!cover_buffer) {
-        cover_buffer = (uint16_t*)malloc(200 * 200 * 2);
+    free(victim->data);
+    *victim = *cover;
+    victim->used = ++covers.ticks;
+
+    xSemaphoreGive(covers.lock);
+}
+
+// The selection moved, whatever is being fetched can be dropped
+static inline bool cover_aborted()
+{
+    return uxQueueMessagesWaiting(covers.queue) > 0;
+}
+
+// The sd card is only accessed when the main task isn't drawing
+static void cover_sd_acquire()
+{
+    xSemaphoreTake(covers.lock, portMAX_DELAY);
+    odroid_system_spi_lock_acquire(SPI_LOCK_SDCARD);
+}
+
+static void cover_sd_release()
+{
+    odroid_system_spi_lock_release(SPI_LOCK_SDCARD);
+    xSemaphoreGive(covers.lock);
+}
+
+static FILE *cover_fopen(const char *path, const char *mode)
+{
+    cover_sd_acquire();
+    FILE *fp = fopen(path, mode);
+    cover_sd_release();
+    return fp;
+}
+
+static void cover_fclose(FILE *fp)
+{
+    cover_sd_acquire();
+    fclose(fp);
+    cover_sd_release();
+}
+
+// Reads in slices so that the display never waits long for the spi bus.
+// Returns the size read or -1 if aborted.
+static int cover_fread(void *buffer, size_t size, FILE *fp)
+{
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        if (cover_aborted())
+            return -1;
+
+        size_t slice = MIN(size - pos, COVER_SLICE_SIZE);
+
+        cover_sd_acquire();
+        size_t count = fread((uint8_t*)buffer + pos, 1, slice, fp);
+        cover_sd_release();
+
+        pos += count;
+        if (count < slice)
+            break;
+
+        // Let the main task through if it's waiting
+        taskYIELD();
     }
 
-    const retro_emulator_file_t *file = gui_list_selected_file(emu);
-    uint32_t *crc = &file->checksum;
-    char path[128], path2[128], buf_crc[10];
+    return pos;
+}
+
+// Returns the rom's crc32, without reading it if it's cached or zipped, 1 if
+// the rom can't be read or 0 if aborted
+static uint32_t cover_checksum(retro_emulator_t *emu, uint32_t key, const char *rom_path)
+{
+    uint32_t crc;
     FILE *fp;
 
-    char *cache_path = odroid_system_get_path(file->path, ODROID_PATH_CRC_CACHE);
+    xSemaphoreTake(covers.lock, portMAX_DELAY);
+    crc = odroid_system_get_rom_crc32(rom_path, emu->ext, emu->crc_offset);
+    xSemaphoreGive(covers.lock);
 
-    if (*crc == 0)
+    if (crc == 0 && (fp = cover_fopen(rom_path, "rb")) != NULL)
     {
-        if ((fp = fopen(cache_path, "rb")) != NULL)
+        long offset = emu->crc_offset;
+
+        if (covers.partial.key == key)
         {
-            fread(crc, 4, 1, fp);
-            fclose(fp);
+            offset = covers.partial.offset;
+            crc = covers.partial.crc;
         }
-        else if ((fp = fopen(file->path, "rb")) != NULL)
-        {
-            odroid_overlay_draw_text(CRC_X_OFFSET, CRC_Y_OFFSET, CRC_WIDTH, (char*)"       CRC32", C_GREEN, C_BLACK);
 
-            fseek(fp, emu->crc_offset, SEEK_SET);
-            int buf_size = 32768;
-            uint32_t crc_tmp = 0;
-            bool abort = false;
+        cover_sd_acquire();
+        fseek(fp, offset, SEEK_SET);
+        cover_sd_release();
 
-            while (true)
-            {
-                odroid_input_gamepad_read(joystick);
-                abort = joystick->bitmask > 0;
-                if (abort) break;
-                int count = fread(cover_buffer, 1, buf_size, fp);
-                crc_tmp = crc32_le(crc_tmp, (const uint8_t*)cover_buffer, count);
-                if (count != buf_size)
-                {
-                    break;
-                }
-            }
-            fclose(fp);
-
-            if (!abort)
+        while (true)
+        {
+            int count = cover_fread(covers.buffer, COVER_SLICE_SIZE, fp);
+            if (count < 0)
             {
-                *crc = crc_tmp;
-                if ((fp = fopen(cache_path, "wb")) != NULL)
-                {
-                    fwrite(crc, 4, 1, fp);
-                    fclose(fp);
-                }
+                covers.partial.key = key;
+                covers.partial.offset = offset;
+                covers.partial.crc = crc;
+                cover_fclose(fp);
+                return 0;
             }
+            crc = crc32_le(crc, covers.buffer, count);
+            offset += count;
+            if (count != COVER_SLICE_SIZE)
+                break;
         }
-        else
+        cover_fclose(fp);
+
+        if (covers.partial.key == key)
+            covers.partial.key = 0;
+
+        if (crc > 1)
         {
-            *crc = 1;
+            xSemaphoreTake(covers.lock, portMAX_DELAY);
+            odroid_system_set_rom_crc32(rom_path, emu->crc_offset, crc);
+            xSemaphoreGive(covers.lock);
         }
-        odroid_overlay_draw_text(CRC_X_OFFSET, CRC_Y_OFFSET, CRC_WIDTH, (char*)" ", C_RED, C_BLACK);
     }
 
-    free(cache_path);
+    return crc > 1 ? crc : 1;
+}
+
+static size_t cover_png_read(void *out, size_t size, size_t count, void *arg)
+{
+    cover_reader_t *reader = (cover_reader_t *)arg;
+    count = MIN(count, (reader->size - reader->pos) / size);
+    memcpy(out, reader->data + reader->pos, count * size);
+    reader->pos += count * size;
+    return count;
+}
+
+// Reads a whole file in one go, returns its size, 0 if it can't be read or
+// -1 if aborted
+static long cover_read_file(const char *path, uint8_t **data)
+{
+    FILE *fp = cover_fopen(path, "rb");
+    if (!fp)
+        return 0;
+
+    cover_sd_acquire();
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    cover_sd_release();
+
+    *data = heap_caps_malloc(MAX(size, 1), MEM_SLOW);
+    long count = *data ? cover_fread(*data, size, fp) : 0;
+    cover_fclose(fp);
 
-    if (*crc > 1)
+    if (count != size)
     {
-        sprintf(buf_crc, "%X", *crc);
+        free(*data);
+        *data = NULL;
+        return count < 0 ? -1 : 0;
+    }
+
+    return size;
+}
+
+// Returns 1 if the thumbnail is up to date with the PNG, 0 if not, -1 if aborted
+static int cover_load_thumb(const char *path, uint32_t mtime, cover_t *cover)
+{
+    cover_thumb_header_t header;
+    uint8_t *data;
+
+    long size = cover_read_file(path, &data);
+    if (size <= 0)
+        return size;
+
+    memcpy(&header, data, MIN(size, sizeof(header)));
+
+    if (size < sizeof(header) || header.magic != COVER_THUMB_MAGIC || header.mtime != mtime
+        || size != sizeof(header) + header.width * header.height * 2)
+    {
+        free(data);
+        return 0;
+    }
 
-        // /sd/romart/gbc/0/08932754.png
-        // /sd/romart/gbc/Super Mario.png
-        sprintf(path, "%s/%s/%c/%s.png", ODROID_BASE_PATH_ROMART, emu->dirname, buf_crc[0], buf_crc);
-        sprintf(path2, "%s/%s/%s.png", ODROID_BASE_PATH_ROMART, emu->dirname, file->name);
-        LuImage *img;
-        if ((img = luPngReadFile(path)) || (img = luPngReadFile(path2)))
+    memmove(data, data + sizeof(header), size - sizeof(header));
+    cover->width = header.width;
+    cover->height = header.height;
+    cover->data = (uint16_t*)data;
+
+    return 1;
+}
+
+static void cover_save_thumb(const char *path, uint32_t mtime, const cover_t *cover)
+{
+    cover_thumb_header_t header = {COVER_THUMB_MAGIC, cover->width, cover->height, mtime};
+    size_t size = cover->width * cover->height * 2;
+    bool failed = false;
+
+    FILE *fp = cover_fopen(path, "wb");
+    if (!fp)
+        return;
+
+    cover_sd_acquire();
+    failed = fwrite(&header, sizeof(header), 1, fp) != 1;
+    cover_sd_release();
+
+    for (size_t pos = 0; pos < size && !failed; pos += COVER_SLICE_SIZE)
+    {
+        size_t slice = MIN(size - pos, COVER_SLICE_SIZE);
+        cover_sd_acquire();
+        failed = fwrite((uint8_t*)cover->data + pos, slice, 1, fp) != 1;
+        cover_sd_release();
+        taskYIELD();
+    }
+
+    cover_fclose(fp);
+
+    if (failed)
+    {
+        printf("cover_save_thumb: Failed writing %s\n", path);
+        unlink(path);
+    }
+}
+
+static int cover_png_row(const uint16_t *row, int32_t y, int32_t width, int32_t height, void *arg)
+{
+    cover_t *cover = (cover_t *)arg;
+
+    if (!cover->data)
+    {
+        cover->width = width;
+        cover->height = height;
+        cover->data = heap_caps_malloc(width * height * 2, MEM_SLOW);
+        if (!cover->data)
+            return 1;
+    }
+
+    memcpy(cover->data + y * width, row, width * 2);
+
+    return cover_aborted();
+}
+
+// The file is read in slices first, the decoding then doesn't hold the bus.
+// Art larger than COVER_MAX_SIZE is scaled down while it's decoded.
+// Returns 1 if the art was found, 0 if not, -1 if aborted.
+static int cover_load_png(const char *path, cover_t *cover)
+{
+    LuUserContext ctx;
+    uint8_t *data;
+
+    long size = cover_read_file(path, &data);
+    if (size <= 0)
+        return size;
+
+    cover_reader_t reader = {data, size, 0};
+    luUserContextInitDefault(&ctx);
+    ctx.readProc = &cover_png_read;
+    ctx.readProcUserPtr = &reader;
+
+    int ret = luPngReadRows(&ctx, COVER_MAX_SIZE, COVER_MAX_SIZE, &cover_png_row, cover);
+    free(data);
+
+    if (ret != 0)
+    {
+        free(cover->data);
+        cover->data = NULL;
+        cover->width = cover->height = 0;
+        return cover_aborted() ? -1 : 0;
+    }
+
+    return 1;
+}
+
+static int cover_load_art(const char *path, cover_t *cover)
+{
+    FILE *fp = cover_fopen(path, "rb");
+    if (!fp)
+        return 0;
+
+    uint16_t header[2] = {0, 0};
+    int ret = cover_fread(header, 4, fp);
+
+    if (ret == 4 && header[0] <= 320 && header[1] <= 176)
+    {
+        size_t size = header[0] * header[1] * 2;
+        cover->width = header[0];
+        cover->height = header[1];
+        cover->data = heap_caps_malloc(MAX(size, 1), MEM_SLOW);
+        if (cover->data && (ret = cover_fread(cover->data, size, fp)) < 0)
         {
-            if (img->width <= 200 && img->height <= 200) {
-                for (int p = 0, i = 0; i < img->dataSize; i += 3) {
-                    uint8_t r = img->data[i];
-                    uint8_t g = img->data[i + 1];
-                    uint8_t b = img->data[i + 2];
-                    cover_buffer[p++] = ((r / 8) << 11) | ((g / 4) << 5) | (b / 8);
-                }
-                odroid_display_write(320 - img->width, 240 - img->height, img->width, img->height, cover_buffer);
-            } else {
-                odroid_overlay_draw_text(CRC_X_OFFSET, CRC_Y_OFFSET, CRC_WIDTH, (char*)"Art too large", C_ORANGE, C_BLACK);
-            }
-            luImageRelease(img, NULL);
-            return;
+            free(cover->data);
+            cover->data = NULL;
         }
+    }
+    cover_fclose(fp);
+
+    return ret < 0 ? -1 : 1;
+}
+
+// Returns false if aborted
+static bool cover_load(retro_emulator_t *emu, const char *rom_path, cover_t *cover)
+{
+    char path[300], png_path[300], name[256], buf_crc[10];
+    struct stat st;
+    int ret = 0;
+
+    if (cover->checksum <= 1)
+        return true;
+
+    // The rom's file name without extension
+    strcpy(name, strrchr(rom_path, '/') + 1);
+    char *ext = strrchr(name, '.');
+    if (ext) *ext = 0;
+
+    sprintf(buf_crc, "%X", cover->checksum);
+
+    // /sd/romart/gbc/0/08932754.png
+    // /sd/romart/gbc/Super Mario.png
+    sprintf(png_path, "%s/%s/%c/%s.png", ODROID_BASE_PATH_ROMART, emu->dirname, buf_crc[0], buf_crc);
+    cover_sd_acquire();
+    bool found = stat(png_path, &st) == 0;
+    if (!found)
+    {
+        snprintf(png_path, sizeof(png_path), "%s/%s/%s.png", ODROID_BASE_PATH_ROMART, emu->dirname, name);
+        found = stat(png_path, &st) == 0;
+    }
+    cover_sd_release();
 
-        // /sd/romart/gbc/0/08932754.art
-        sprintf(path, "%s/%s/%c/%s.art", ODROID_BASE_PATH_ROMART, emu->dirname, buf_crc[0], buf_crc);
-        if ((fp = fopen(path, "rb")) != NULL)
+    // The decoded PNG is kept in the cover cache, it's then a single read
+    // /sd/odroid/cache/covers/gbc/8932754.cover
+    if (found)
+    {
+        sprintf(path, "%s/%s/%s.cover", ODROID_BASE_PATH_COVER_CACHE, emu->dirname, buf_crc);
+        ret = cover_load_thumb(path, st.st_mtime, cover);
+        if (ret == 0 && (ret = cover_load_png(png_path, cover)) == 1 && cover->data)
+            cover_save_thumb(path, st.st_mtime, cover);
+    }
+
+    // /sd/romart/gbc/0/08932754.art
+    sprintf(path, "%s/%s/%c/%s.art", ODROID_BASE_PATH_ROMART, emu->dirname, buf_crc[0], buf_crc);
+    if (ret == 0) ret = cover_load_art(path, cover);
+
+    return ret >= 0;
+}
+
+// Computes the checksums and decodes the covers of the selection and its
+// neighbors, the main task only ever waits for one slice of sd card access
+static void cover_task(void *arg)
+{
+    static cover_request_t request;
+
+    while (1)
+    {
+        xQueueReceive(covers.queue, &request, portMAX_DELAY);
+
+        for (int i = 0; i < request.count && !cover_aborted(); i++)
         {
-            uint16_t width, height;
-            fread(&width, 2, 1, fp);
-            fread(&height, 2, 1, fp);
-            if (width <= 320 && height <= 176)
+            uint32_t start_time = get_elapsed_time();
+
+            xSemaphoreTake(covers.lock, portMAX_DELAY);
+            bool cached = cover_find(request.files[i].key) != NULL;
+            xSemaphoreGive(covers.lock);
+
+            if (cached)
+                continue;
+
+            cover_t cover = {request.files[i].key, request.files[i].checksum};
+
+            if (cover.checksum == 0)
+                cover.checksum = cover_checksum(request.emu, cover.key, request.files[i].path);
+
+            if (cover.checksum == 0 || !cover_load(request.emu, request.files[i].path, &cover))
             {
-                fread(cover_buffer, 2, width * height, fp);
-                odroid_display_write(320 - width, 240 - height, width, height, cover_buffer);
+                free(cover.data);
+                break;
             }
-            fclose(fp);
-            return;
+
+            cover_insert(&cover);
+
+            printf("cover_task: %s: %dx%d ready in %dms\n", request.files[i].path,
+                cover.width, cover.height, get_elapsed_time_since(start_time) / 1000);
+        }
+    }
+}
+
+void gui_cover_prefetch(retro_emulator_t *emu)
+{
+    static cover_request_t request;
+
+    if (!covers.queue)
+    {
+        covers.buffer = malloc(COVER_SLICE_SIZE);
+        covers.lock = xSemaphoreCreateMutex();
+        covers.queue = xQueueCreate(1, sizeof(cover_request_t));
+        xTaskCreatePinnedToCore(&cover_task, "cover_task", 4096, NULL, 1, NULL, 0);
+    }
+
+    request.emu = emu;
+    request.count = 0;
+
+    // The selection first, then its neighbors outwards
+    for (int i = 0; i <= COVER_NEIGHBORS * 2; i++)
+    {
+        int entry = emu->roms.selected + (i % 2 ? (i + 1) / 2 : -(i / 2));
+        if (entry < 0 || entry >= emu->roms.count)
+            continue;
+
+        const retro_emulator_file_t *file = &emu->roms.files[entry];
+        char *path = emulators_file_path(emu, file);
+        size_t len = strlen(path);
+
+        if (len < sizeof(request.files[0].path))
+        {
+            request.files[request.count].key = crc32_le(0, (uint8_t*)path, len);
+            request.files[request.count].checksum = file->checksum;
+            strcpy(request.files[request.count].path, path);
+            request.count++;
+        }
+        free(path);
+    }
+
+    xQueueOverwrite(covers.queue, &request);
+
+    covers.shown = false;
+    covers.selected_time = get_elapsed_time();
+}
+
+void gui_cover_draw(retro_emulator_t *emu)
+{
+    if (covers.shown || !covers.lock || emu->roms.count == 0 || emu->roms.selected >= emu->roms.count) {
+        return;
+    }
+
+    retro_emulator_file_t *file = &emu->roms.files[emu->roms.selected];
+    char *path = emulators_file_path(emu, file);
+    uint32_t key = crc32_le(0, (uint8_t*)path, strlen(path));
+    free(path);
+
+    xSemaphoreTake(covers.lock, portMAX_DELAY);
+
+    cover_t *cover = cover_find(key);
+    if (cover)
+    {
+        file->checksum = cover->checksum;
+
+        if (cover->data) {
+            odroid_display_write(320 - cover->width, 240 - cover->height, cover->width, cover->height, cover->data);
+        } else {
+            odroid_overlay_draw_text(CRC_X_OFFSET, CRC_Y_OFFSET, CRC_WIDTH, (char*)"No art found", C_RED, C_BLACK);
         }
 
-        *crc = 1;
+        printf("gui_cover_draw: Shown %dms after selection\n", get_elapsed_time_since(covers.selected_time) / 1000);
+        covers.shown = true;
     }
 
-    odroid_overlay_draw_text(CRC_X_OFFSET, CRC_Y_OFFSET, CRC_WIDTH, (char*)"No art found", C_RED, C_BLACK);
+    xSemaphoreGive(covers.lock);
 }
@@ -67,6 +67,58 @@ static bool show_cover_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t
     return event == ODROID_DIALOG_ENTER;
 }
 
+static bool compress_saves_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t event)
+{
+    int compress = odroid_settings_CompressSaves_get();
+    if (event == ODROID_DIALOG_PREV || event == ODROID_DIALOG_NEXT) {
+        compress = !compress;
+        odroid_settings_CompressSaves_set(compress);
+    }
+    strcpy(option->value, compress ? "Yes" : "No");
+    return event == ODROID_DIALOG_ENTER;
+}
+
+static bool sd_high_speed_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t event)
+{
+    int high_speed = odroid_settings_SDHighSpeed_get();
+    if (event == ODROID_DIALOG_PREV || event == ODROID_DIALOG_NEXT) {
+        high_speed = !high_speed;
+        odroid_settings_SDHighSpeed_set(high_speed);
+    }
+    // Applied when the next app starts
+    strcpy(option->value, high_speed ? "Yes" : "No");
+    return event == ODROID_DIALOG_ENTER;
+}
+
+static void sd_speed_test()
+{
+    if (emu->roms.selected >= emu->roms.count) {
+        odroid_overlay_alert("Select a rom to read first");
+        return;
+    }
+
+    char *rom_path = emulators_file_path(emu, gui_list_selected_file(emu));
+    char sequential[16], random[16], clock[16];
+
+    odroid_overlay_draw_text(58, 35, 320 - 58, "Testing...", C_WHITE, C_BLACK);
+    odroid_sdcard_speed_t speed = odroid_sdcard_speed_test(rom_path);
+    free(rom_path);
+
+    sprintf(sequential, "%.2f MB/s", speed.sequential);
+    sprintf(random, "%.2f MB/s", speed.random);
+    sprintf(clock, "%d MHz", speed.freq_khz / 1000);
+
+    odroid_dialog_choice_t choices[] = {
+        {0, "Sequential", sequential, 1, NULL},
+        {0, "Random 16K", random, 1, NULL},
+        {0, "Clock", clock, 1, NULL},
+        {0, "", "", -1, NULL},
+        {0, "Close", "", 1, NULL},
+        ODROID_DIALOG_CHOICE_LAST
+    };
+    odroid_overlay_dialog("SD card speed", choices, 4);
+}
+
 static bool color_shift_cb(odroid_dialog_choice_t *option, odroid_dialog_event_t event)
 {
     int max = gui_themes_count - 1;
@@ -150,6 +202,12 @@ void retro_loop()
             redraw = true;
         }
 
+        if (emulators_refresh() == emu)
+        {
+            gui_header_draw(emu);
+            redraw = true;
+        }
+
         if (redraw || idle_counter % 100 == 0)
         {
             odroid_overlay_draw_battery(320 - 26, 3);
@@ -158,15 +216,16 @@ void retro_loop()
         if (redraw)
         {
             gui_list_draw(emu, theme);
+            if (show_cover) gui_cover_prefetch(emu);
             redraw = false;
         }
 
         odroid_gamepad_state joystick;
         odroid_input_gamepad_read(&joystick);
 
-        if (show_cover && idle_counter == (show_cover == 1 ? 8 : 1))
+        if (show_cover && idle_counter >= (show_cover == 1 ? 8 : 1))
         {
-            gui_cover_draw(emu, &joystick);
+            gui_cover_draw(emu);
         }
 
         if (last_key >= 0) {
@@ -182,8 +241,9 @@ void retro_loop()
                 last_key = ODROID_INPUT_A;
                 if (emu->roms.selected < emu->roms.count)
                 {
-                    char *rom_path = gui_list_selected_file(emu)->path;
+                    char *rom_path = emulators_file_path(emu, gui_list_selected_file(emu));
                     char *save_path = odroid_system_get_path(rom_path, ODROID_PATH_SAVE_STATE);
+                    free(rom_path);
                     bool has_save = access(save_path, F_OK) != -1;
 
                     odroid_dialog_choice_t choices[] = {
@@ -232,14 +292,18 @@ void retro_loop()
                     {0, "Date", COMPILEDATE, 1, NULL},
                     {0, "Commit", GITREV, 1, NULL},
                     {0, "", "", -1, NULL},
+                    {2, "SD card speed test", "", 1, NULL},
                     {1, "Reboot to firmware", "", 1, NULL},
                     {0, "Close", "", 1, NULL},
                     ODROID_DIALOG_CHOICE_LAST
                 };
-                int sel = odroid_overlay_dialog("Retro-Go", choices, 4);
+                int sel = odroid_overlay_dialog("Retro-Go", choices, 5);
                 if (sel == 1) {
                     odroid_system_switch_app(-16);
                 }
+                else if (sel == 2) {
+                    sd_speed_test();
+                }
                 selected_emu_last = -1;
                 redraw = true;
             }
@@ -251,6 +315,8 @@ void retro_loop()
                     {0, "Font size", "Small", 1, &font_size_cb},
                     {0, "Show cover", "Yes", 1, &show_cover_cb},
                     {0, "Show empty", "Yes", 1, &hide_empty_cb},
+                    {0, "Compress saves", "Yes", 1, &compress_saves_cb},
+                    {0, "SD high speed", "No", 1, &sd_high_speed_cb},
                     ODROID_DIALOG_CHOICE_LAST
                 };
                 odroid_overlay_settings_menu(choices);
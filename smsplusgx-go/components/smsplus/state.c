@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "shared.h"
+#include <stddef.h>
 
 //static unsigned char* state = (unsigned char*)ESP32_PSRAM + 0x100000; //[0x10000];
 //static unsigned int bufferptr;
@@ -39,14 +40,54 @@ system_save_state: sizeof Z80=72
 system_save_state: sizeof SN76489_Context=92
 */
 
-int system_save_state(void *mem)
+static void state_restore_mapping(void)
 {
   int i;
 
-  printf("%s: sizeof sms=%d\n", __func__, sizeof(sms));
-  printf("%s: sizeof vdp=%d\n", __func__, sizeof(vdp));
-  printf("%s: sizeof Z80=%d\n", __func__, sizeof(Z80));
-  printf("%s: sizeof SN76489_Context=%d\n", __func__, sizeof(SN76489_Context));
+  if ((sms.console != CONSOLE_COLECO) && (sms.console != CONSOLE_SG1000))
+  {
+    /* Cartridge by default */
+    slot.rom    = cart.rom;
+    slot.pages  = cart.pages;
+    slot.mapper = cart.mapper;
+    slot.fcr = &cart.fcr[0];
+
+    /* Restore mapping */
+    mapper_reset();
+    cpu_readmap[0]  = &slot.rom[0];
+    if (slot.mapper != MAPPER_KOREA_MSX)
+    {
+      mapper_16k_w(0,slot.fcr[0]);
+      mapper_16k_w(1,slot.fcr[1]);
+      mapper_16k_w(2,slot.fcr[2]);
+      mapper_16k_w(3,slot.fcr[3]);
+    }
+    else
+    {
+      mapper_8k_w(0,slot.fcr[0]);
+      mapper_8k_w(1,slot.fcr[1]);
+      mapper_8k_w(2,slot.fcr[2]);
+      mapper_8k_w(3,slot.fcr[3]);
+    }
+  }
+
+  // /* Force full pattern cache update */
+  // bg_list_index = 0x200;
+  // for(i = 0; i < 0x200; i++)
+  // {
+  //   bg_name_list[i] = i;
+  //   bg_name_dirty[i] = -1;
+  // }
+
+  /* Restore palette */
+  for(i = 0; i < PALETTE_SIZE; i++)
+    palette_sync(i);
+}
+
+
+int system_save_state(void *mem)
+{
+  int i;
 
   /*** Save SMS Context ***/
   fwrite(&sms, sizeof(sms), 1, mem);
@@ -75,6 +116,9 @@ int system_save_state(void *mem)
   /*** Save SN76489 ***/
   fwrite(SN76489_GetContextPtr(0), SN76489_GetContextSize(), 1, mem);
 
+  /*** Save Z80 cycles carried into the next frame (older saves end before) ***/
+  fwrite(&z80_cycle_count, sizeof(z80_cycle_count), 1, mem);
+
   return 0;
 }
 
@@ -84,11 +128,6 @@ void system_load_state(void *mem)
   int i;
   uint8 *buf;
 
-  printf("%s: sizeof sms=%d\n", __func__, sizeof(sms));
-  printf("%s: sizeof vdp=%d\n", __func__, sizeof(vdp));
-  printf("%s: sizeof Z80=%d\n", __func__, sizeof(Z80));
-  printf("%s: sizeof SN76489_Context=%d\n", __func__, sizeof(SN76489_Context));
-
   /* Initialize everything */
   system_reset();
 
@@ -143,47 +182,102 @@ void system_load_state(void *mem)
   /*** Set SN76489 ***/
   fread(SN76489_GetContextPtr(0), SN76489_GetContextSize(), 1, mem);
 
+  /*** Set Z80 cycles carried into the next frame ***/
+  z80_reset_cycle_count();
+  fread(&z80_cycle_count, sizeof(z80_cycle_count), 1, mem);
+
   // Restore clock rate
   psg->Clock = psg_Clock;
   psg->dClock = psg_dClock;
 
 
-  if ((sms.console != CONSOLE_COLECO) && (sms.console != CONSOLE_SG1000))
+  state_restore_mapping();
+}
+
+
+int system_state_size(void)
+{
+  return sizeof(sms) + sizeof(vdp) + 4 + 0x8000 + sizeof(Z80) + SN76489_GetContextSize()
+    + sizeof(z80_cycle_count);
+}
+
+
+int system_save_state_mem(void *buffer, int size)
+{
+  FILE *fp;
+  int len;
+
+  if (size < system_state_size())
+    return -1;
+
+  if (!(fp = fmemopen(buffer, size, "wb")))
+    return -1;
+
+  system_save_state(fp);
+  fflush(fp);
+  len = ftell(fp);
+  fclose(fp);
+
+  return len;
+}
+
+
+/* Snapshots taken during this session (rewind, netplay) are restored with
+   plain copies, there is no need to reset the machine or reinit the audio
+   since the timings can't have changed. */
+int system_load_state_mem(const void *buffer, int size)
+{
+  const uint8 *ptr = buffer;
+  uint8 console;
+
+  if (size < system_state_size())
+    return -1;
+
+  memcpy(&console, ptr + offsetof(sms_t, console), sizeof(console));
+  if (console != sms.console)
   {
-    /* Cartridge by default */
-    slot.rom    = cart.rom;
-    slot.pages  = cart.pages;
-    slot.mapper = cart.mapper;
-    slot.fcr = &cart.fcr[0];
+    printf("%s: Bad save data\n", __func__);
+    return -1;
+  }
 
-    /* Restore mapping */
-    mapper_reset();
-    cpu_readmap[0]  = &slot.rom[0];
-    if (slot.mapper != MAPPER_KOREA_MSX)
-    {
-      mapper_16k_w(0,slot.fcr[0]);
-      mapper_16k_w(1,slot.fcr[1]);
-      mapper_16k_w(2,slot.fcr[2]);
-      mapper_16k_w(3,slot.fcr[3]);
-    }
-    else
-    {
-      mapper_8k_w(0,slot.fcr[0]);
-      mapper_8k_w(1,slot.fcr[1]);
-      mapper_8k_w(2,slot.fcr[2]);
-      mapper_8k_w(3,slot.fcr[3]);
-    }
+  memcpy(&sms, ptr, sizeof(sms));
+  ptr += sizeof(sms);
+
+  memcpy(&vdp, ptr, sizeof(vdp));
+  ptr += sizeof(vdp);
+
+  memcpy(&cart.fcr[0], ptr, 4);
+  ptr += 4;
+
+  memcpy(&cart.sram[0], ptr, 0x8000);
+  ptr += 0x8000;
+
+  int (*irq_cb)(int) = Z80.irq_callback;
+  memcpy(&Z80, ptr, sizeof(Z80));
+  Z80.irq_callback = irq_cb;
+  ptr += sizeof(Z80);
+
+  /* Clock is the sample phase and comes from the state, only the rate is ours */
+  SN76489_Context* psg = (SN76489_Context*)SN76489_GetContextPtr(0);
+  float psg_dClock = psg->dClock;
+  memcpy(psg, ptr, SN76489_GetContextSize());
+  psg->dClock = psg_dClock;
+  ptr += SN76489_GetContextSize();
+
+  memcpy(&z80_cycle_count, ptr, sizeof(z80_cycle_count));
+
+  if (vdp.mode & 8)
+  {
+    render_bg  = render_bg_sms;
+    render_obj = render_obj_sms;
+  }
+  else
+  {
+    render_bg  = render_bg_tms;
+    render_obj = render_obj_tms;
   }
 
-  // /* Force full pattern cache update */
-  // bg_list_index = 0x200;
-  // for(i = 0; i < 0x200; i++)
-  // {
-  //   bg_name_list[i] = i;
-  //   bg_name_dirty[i] = -1;
-  // }
+  state_restore_mapping();
 
-  /* Restore palette */
-  for(i = 0; i < PALETTE_SIZE; i++)
-    palette_sync(i);
+  return 0;
 }
@@ -32,5 +32,8 @@
 /* Function prototypes */
 extern int system_save_state(void *mem);
 extern void system_load_state(void *mem);
+extern int system_state_size(void);
+extern int system_save_state_mem(void *buffer, int size);
+extern int system_load_state_mem(const void *buffer, int size);
 
 #endif /* _STATE_H_ */
@@ -81,7 +81,7 @@ static void netplay_callback(netplay_event_t event, void *arg)
 
 static bool SaveState(char *pathName)
 {
-    FILE* f = fopen(pathName, "w");
+    FILE* f = odroid_sdcard_fopen(pathName, "wb");
     if (f == NULL)
         return false;
 
@@ -91,9 +91,23 @@ static bool SaveState(char *pathName)
     return true;
 }
 
+static size_t SaveStateMem(void *buffer, size_t size)
+{
+    if (buffer == NULL)
+        return system_state_size();
+
+    int len = system_save_state_mem(buffer, size);
+    return len > 0 ? len : 0;
+}
+
+static size_t LoadStateMem(void *buffer, size_t size)
+{
+    return system_load_state_mem(buffer, size) == 0 ? size : 0;
+}
+
 static bool LoadState(char *pathName)
 {
-    FILE* f = fopen(pathName, "r");
+    FILE* f = odroid_sdcard_fopen(pathName, "rb");
     if (f == NULL)
     {
         system_reset();
@@ -119,6 +133,7 @@ void app_main(void)
     // Init all the console hardware
     odroid_system_init(APP_ID, AUDIO_SAMPLE_RATE);
     odroid_system_emu_init(&LoadState, &SaveState, NULL);
+    odroid_system_emu_set_state_mem_handler(&LoadStateMem, &SaveStateMem);
 
     update1.buffer = rg_alloc(SMS_WIDTH * SMS_HEIGHT, MEM_ANY);
     update2.buffer = rg_alloc(SMS_WIDTH * SMS_HEIGHT, MEM_ANY);
@@ -185,6 +200,8 @@ void app_main(void)
             odroid_overlay_game_settings_menu(NULL);
         }
 
+        odroid_system_rewind_tick(localJoystick);
+
         uint startTime = get_elapsed_time();
         bool drawFrame = !skipFrames;
 
@@ -0,0 +1,77 @@
+/* Host stand-ins for the odroid component functions the emulator cores call */
+
+#include "odroid_system.h"
+#include "rom/crc.h"
+
+// Same as the ROM function: zlib compatible when starting from 0
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+void *rg_alloc(size_t size, uint32_t caps)
+{
+    void *ptr = calloc(1, size);
+    if (!ptr)
+    {
+        printf("rg_alloc: Memory allocation failed (%u)\n", (unsigned)size);
+        abort();
+    }
+    return ptr;
+}
+
+void odroid_system_panic(const char *reason)
+{
+    printf("odroid_system_panic: %s\n", reason);
+    abort();
+}
+
+size_t odroid_sdcard_copy_file_to_memory(const char *path, void *buf, size_t buf_size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+    size_t count = fread(buf, 1, buf_size, fp);
+    fclose(fp);
+    return count;
+}
+
+FILE *odroid_sdcard_fopen(const char *path, const char *mode)
+{
+    return fopen(path, mode);
+}
+
+odroid_zip_t *odroid_sdcard_zip_open(const char *path, const char *exts)
+{
+    return NULL;
+}
+
+size_t odroid_sdcard_zip_read(odroid_zip_t *zip, size_t offset, void *buf, size_t size)
+{
+    return 0;
+}
+
+size_t odroid_sdcard_zip_size(odroid_zip_t *zip)
+{
+    return 0;
+}
+
+void odroid_sdcard_zip_close(odroid_zip_t *zip)
+{
+}
+
+uint32_t odroid_system_get_rom_crc32(const char *romPath, const char *exts, size_t skip)
+{
+    return 0;
+}
+
+void odroid_system_set_rom_crc32(const char *romPath, size_t skip, uint32_t crc)
+{
+}
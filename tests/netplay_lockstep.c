@@ -0,0 +1,222 @@
+/* Netplay against lockstep: two peers run on this machine, over UDP on the
+   loopback with delay, jitter and loss added, and play the same input trace.
+   Whatever the sync does (waiting, predicting, rolling back, transferring the
+   state) each peer must end on the state of a plain lockstep run of the
+   trace. The emulator is a small deterministic stand-in. */
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+#include "odroid_system.h"
+#include "odroid_netplay_sync.h"
+
+#define TRACE_FRAMES 300
+#define TRACE_TAIL   32 // Neutral inputs at the end, so that no prediction is left wrong
+
+static struct {
+    uint32_t frame;
+    uint32_t hash;
+    uint8_t  ram[4096];
+} core;
+
+static odroid_gamepad_state trace[2][TRACE_FRAMES];
+static int player;
+
+static const struct {
+    const char *name;
+    int delay, rollback;
+    int latency, jitter, loss; // Added to each peer's incoming packets
+} scenarios[] = {
+    {"lockstep",            2, 0,  0,  0,  0},
+    {"lockstep, lossy",     3, 0, 10,  5, 20},
+    {"rollback",            1, 1,  0,  0,  0},
+    {"rollback, lossy",     1, 1, 20, 10, 10},
+    {"rollback, no delay",  0, 1, 30, 15,  5},
+};
+
+size_t odroid_system_emu_save_state_mem(void *buffer, size_t size)
+{
+    if (buffer == NULL)
+        return sizeof(core);
+    if (size < sizeof(core))
+        return 0;
+    memcpy(buffer, &core, sizeof(core));
+    return sizeof(core);
+}
+
+size_t odroid_system_emu_load_state_mem(void *buffer, size_t size)
+{
+    if (size != sizeof(core))
+        return 0;
+    memcpy(&core, buffer, sizeof(core));
+    return size;
+}
+
+static void core_frame(const odroid_gamepad_state *p1, const odroid_gamepad_state *p2)
+{
+    for (int i = 0; i < ODROID_INPUT_MAX; i++)
+        core.hash = core.hash * 31 + p1->values[i] * 3 + p2->values[i] * 7 + 1;
+    core.ram[core.hash % sizeof(core.ram)] ^= core.hash >> 24;
+    core.frame++;
+}
+
+static void run_frame(void *local, void *remote)
+{
+    if (player == 0)
+        core_frame(local, remote);
+    else
+        core_frame(remote, local);
+}
+
+static void core_init(int seed)
+{
+    core.frame = 0;
+    core.hash = seed;
+    for (int i = 0; i < sizeof(core.ram); i++)
+        core.ram[i] = (i * 7 + seed) & 0xFF;
+}
+
+// Buttons held for a few frames at a time, like a player would
+static void make_trace(void)
+{
+    uint32_t seed = 1;
+
+    for (int p = 0; p < 2; p++)
+    {
+        for (int f = 0; f < TRACE_FRAMES - TRACE_TAIL; f++)
+        {
+            if (f % 5 == 0)
+                seed = seed * 1103515245 + 12345;
+            trace[p][f].values[(seed >> 16) % ODROID_INPUT_MAX] = 1;
+            trace[p][f].values[(seed >> 24) % ODROID_INPUT_MAX] = 1;
+        }
+    }
+}
+
+// The host's state is what both peers start from once it's transferred
+static uint32_t lockstep_hash(int delay)
+{
+    const odroid_gamepad_state neutral = {0};
+
+    core_init(1234);
+    for (int f = 0; f < TRACE_FRAMES; f++)
+    {
+        if (f < delay)
+            core_frame(&neutral, &neutral);
+        else
+            core_frame(&trace[0][f - delay], &trace[1][f - delay]);
+    }
+
+    return core.hash;
+}
+
+static void run_peer(int n, int port, int result_fd)
+{
+    const uint32_t expected = lockstep_hash(scenarios[n].delay);
+    const netplay_transport_t *transport = netplay_transport_udp(port + player, port + !player);
+
+    transport = netplay_transport_impaired(transport, scenarios[n].latency, scenarios[n].jitter,
+                                           scenarios[n].loss);
+    if (!(*transport->open)())
+    {
+        printf("%s: transport open failed\n", scenarios[n].name);
+        exit(1);
+    }
+
+    core_init(player == 0 ? 1234 : 5678);
+
+    odroid_netplay_set_input_delay(scenarios[n].delay);
+    if (scenarios[n].rollback)
+        odroid_netplay_set_rollback(&run_frame);
+
+    netplay_peer_t peer = {
+        .transport = transport,
+        .local_id = player,
+        .remote_id = !player,
+        .remote_addr = inet_addr("127.0.0.1"),
+        .host = player == 0,
+    };
+    netplay_sync_start(&peer);
+
+    // Keeps playing neutral inputs after the trace so that the other peer gets
+    // what it needs until it's done too, the parent stops both
+    for (uint32_t f = 0;; f++)
+    {
+        odroid_gamepad_state local = {0}, remote;
+
+        if (f < TRACE_FRAMES)
+            local = trace[player][f];
+
+        if (!netplay_sync_frame(&local, &remote, sizeof(local)))
+        {
+            printf("%s: peer %d lost the sync at frame %d\n", scenarios[n].name, player, f);
+            exit(1);
+        }
+
+        run_frame(&local, &remote);
+
+        if (f == TRACE_FRAMES - 1)
+        {
+            netplay_stats_t stats = odroid_netplay_get_stats(false);
+            char ok = core.hash == expected && stats.desyncs == 0;
+
+            printf("%s: peer %d %s (%08x, lockstep %08x), %d stalls, %d lost, %d rollbacks, %d resimulated\n",
+                scenarios[n].name, player, ok ? "OK" : "FAIL", core.hash, expected, stats.stalls,
+                stats.packets_lost, stats.rollbacks, stats.resimulated);
+            fflush(stdout);
+
+            write(result_fd, &ok, 1);
+        }
+    }
+}
+
+static int test_scenario(int n)
+{
+    int port = 20000 + (getpid() % 20000) * 2;
+    int results[2];
+    pid_t pids[2];
+    int failed = 0;
+
+    pipe(results);
+
+    for (int p = 0; p < 2; p++)
+    {
+        if ((pids[p] = fork()) == 0)
+        {
+            close(results[0]);
+            player = p;
+            run_peer(n, port, results[1]);
+        }
+    }
+    close(results[1]);
+
+    for (int p = 0; p < 2; p++)
+    {
+        char ok = 0;
+        if (read(results[0], &ok, 1) != 1 || !ok)
+            failed = 1;
+    }
+    close(results[0]);
+
+    for (int p = 0; p < 2; p++)
+    {
+        kill(pids[p], SIGTERM);
+        waitpid(pids[p], NULL, 0);
+    }
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+
+    make_trace();
+
+    for (int n = 0; n < sizeof(scenarios) / sizeof(scenarios[0]); n++)
+        failed += test_scenario(n);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,591 @@
+/* lupng row decoding: generated PNGs of every color type and bit depth, with
+   all five filters and Adam7, are decoded whole (luPngReadUC) and a row at a
+   time (luPngReadRows). Both must give back the pixels that were encoded, and
+   rows scaled down to fit a cover must be the box average of them (sampled
+   for interlaced images). Time and peak heap of both modes are printed.
+
+   With a directory argument, the PNG files in it are decoded both ways to
+   fit a cover instead, and the rows are checked against the full decode:
+       tests/png_rows path/to/covers */
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "lupng.h"
+#include "miniz.h"
+#include "esp_timer.h"
+
+#define COVER_MAX_SIZE 200 // Same as the launcher
+
+typedef struct {
+    const char *name;
+    uint8_t colorType;
+    uint8_t depth;
+    uint8_t interlace;
+    int width, height;
+} format_t;
+
+static const format_t formats[] = {
+    {"gray 1",        0,  1, 0,  37,  23},
+    {"gray 2",        0,  2, 0,  37,  23},
+    {"gray 4",        0,  4, 0,  37,  23},
+    {"gray 8",        0,  8, 0,  37,  23},
+    {"gray 16",       0, 16, 0,  37,  23},
+    {"rgb 8",         2,  8, 0,  37,  23},
+    {"rgb 16",        2, 16, 0,  37,  23},
+    {"paletted 1",    3,  1, 0,  37,  23},
+    {"paletted 2",    3,  2, 0,  37,  23},
+    {"paletted 4",    3,  4, 0,  37,  23},
+    {"paletted 8",    3,  8, 0,  37,  23},
+    {"gray alpha 8",  4,  8, 0,  37,  23},
+    {"gray alpha 16", 4, 16, 0,  37,  23},
+    {"rgba 8",        6,  8, 0,  37,  23},
+    {"rgba 16",       6, 16, 0,  37,  23},
+    {"gray 4 adam7",  0,  4, 1,  37,  23},
+    {"rgb 8 adam7",   2,  8, 1,  37,  23},
+    {"paletted adam7",3,  8, 1,  37,  23},
+    {"rgba 8 adam7",  6,  8, 1,   5,   3},
+    {"rgb 8 art",     2,  8, 0, 400, 300},
+    {"rgba 8 art",    6,  8, 0, 256, 224},
+    {"paletted art",  3,  8, 0, 301, 213},
+    {"rgb 8 adam7 art", 2, 8, 1, 400, 300},
+};
+
+static const int adam7[7][4] = { // x0, y0, dx, dy
+    {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2},
+};
+
+// Allocations are tracked to find the peak heap use of a decode
+static size_t heap_used, heap_peak;
+
+static void *track_alloc(size_t size, void *user)
+{
+    size_t *ptr = malloc(size + sizeof(size_t));
+    if (!ptr)
+        return NULL;
+    *ptr = size;
+    heap_used += size;
+    if (heap_used > heap_peak)
+        heap_peak = heap_used;
+    return ptr + 1;
+}
+
+static void track_free(void *ptr, void *user)
+{
+    if (ptr)
+    {
+        heap_used -= ((size_t*)ptr)[-1];
+        free((size_t*)ptr - 1);
+    }
+}
+
+typedef struct {
+    const uint8_t *data;
+    size_t size, pos;
+} reader_t;
+
+static size_t mem_read(void *out, size_t size, size_t count, void *user)
+{
+    reader_t *reader = (reader_t*)user;
+    size_t len = size * count;
+    if (len > reader->size - reader->pos)
+        len = reader->size - reader->pos;
+    memcpy(out, reader->data + reader->pos, len);
+    reader->pos += len;
+    return len / size;
+}
+
+static void context_init(LuUserContext *ctx, reader_t *reader)
+{
+    luUserContextInitDefault(ctx);
+    ctx->readProc = &mem_read;
+    ctx->readProcUserPtr = reader;
+    ctx->allocProc = &track_alloc;
+    ctx->freeProc = &track_free;
+    ctx->warnProc = NULL;
+}
+
+static uint16_t rgb565(uint32_t r, uint32_t g, uint32_t b)
+{
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+/* Encoding */
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} buffer_t;
+
+static void put(buffer_t *buf, const void *data, size_t len)
+{
+    buf->data = realloc(buf->data, buf->size + len);
+    memcpy(buf->data + buf->size, data, len);
+    buf->size += len;
+}
+
+static void put32(buffer_t *buf, uint32_t value)
+{
+    uint8_t bytes[4] = {value >> 24, value >> 16, value >> 8, value};
+    put(buf, bytes, 4);
+}
+
+static void put_chunk(buffer_t *buf, const char *type, const void *data, size_t len)
+{
+    uint32_t crc = mz_crc32(MZ_CRC32_INIT, (const uint8_t*)type, 4);
+    crc = mz_crc32(crc, data, len);
+    put32(buf, len);
+    put(buf, type, 4);
+    put(buf, data, len);
+    put32(buf, crc);
+}
+
+static int channels_of(uint8_t colorType)
+{
+    const int channels[] = {1, 0, 3, 1, 2, 0, 4};
+    return channels[colorType];
+}
+
+// The image as encoded: samples (palette indexes for paletted images)
+typedef struct {
+    const format_t *format;
+    uint16_t *samples;
+    uint8_t palette[256 * 3];
+    int paletteItems;
+} image_t;
+
+static void image_generate(image_t *img, const format_t *format, uint32_t seed)
+{
+    int channels = channels_of(format->colorType);
+    int max = (1 << format->depth) - 1;
+
+    img->format = format;
+    img->samples = malloc(format->width * format->height * channels * sizeof(uint16_t));
+    img->paletteItems = format->colorType == 3 ? (max + 1 < 200 ? max + 1 : 200) : 0;
+
+    for (int i = 0; i < img->paletteItems * 3; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        img->palette[i] = seed >> 16;
+    }
+
+    // Gradients with some noise, so that every filter has something to do
+    for (int y = 0; y < format->height; y++)
+    {
+        for (int x = 0; x < format->width; x++)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                seed = seed * 1103515245 + 12345;
+                uint32_t v = (x * 2048 / format->width + y * 1024 / format->height + c * 4000) + ((seed >> 16) & 127);
+                if (format->depth < 16)
+                    v >>= 16 - format->depth > 8 ? 8 : 16 - format->depth;
+                if (img->paletteItems)
+                    v %= img->paletteItems;
+                img->samples[(y * format->width + x) * channels + c] = v & max;
+            }
+        }
+    }
+}
+
+// Filters one row in place, prev is the previous unfiltered row or zeros
+static void filter_row(uint8_t type, uint8_t *out, const uint8_t *row, const uint8_t *prev, int len, int bpp)
+{
+    for (int i = 0; i < len; i++)
+    {
+        int a = i >= bpp ? row[i - bpp] : 0, b = prev[i], c = i >= bpp ? prev[i - bpp] : 0;
+        int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+        int pred = 0;
+
+        switch (type)
+        {
+            case 1: pred = a; break;
+            case 2: pred = b; break;
+            case 3: pred = (a + b) / 2; break;
+            case 4: pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c); break;
+        }
+
+        out[i] = row[i] - pred;
+    }
+}
+
+static buffer_t image_encode(const image_t *img)
+{
+    const format_t *format = img->format;
+    int channels = channels_of(format->colorType);
+    int bits = channels * format->depth;
+    int bpp = bits >= 8 ? bits / 8 : 1;
+    int passes = format->interlace ? 7 : 1;
+    buffer_t raw = {0}, png = {0};
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+        const int *p = format->interlace ? adam7[pass] : (const int[]){0, 0, 1, 1};
+        int width = (format->width - p[0] + p[2] - 1) / p[2];
+        int height = (format->height - p[1] + p[3] - 1) / p[3];
+        int len = (width * bits + 7) / 8;
+
+        if (width <= 0 || height <= 0)
+            continue;
+
+        uint8_t *prev = calloc(len, 1), *row = calloc(len, 1), *out = malloc(len + 1);
+
+        for (int y = 0; y < height; y++)
+        {
+            memset(row, 0, len);
+
+            for (int x = 0, bit = 0; x < width; x++)
+            {
+                const uint16_t *s = img->samples + ((p[1] + y * p[3]) * format->width + p[0] + x * p[2]) * channels;
+
+                for (int c = 0; c < channels; c++, bit += format->depth)
+                {
+                    if (format->depth == 16)
+                    {
+                        row[bit / 8] = s[c] >> 8;
+                        row[bit / 8 + 1] = s[c];
+                    }
+                    else
+                    {
+                        row[bit / 8] |= s[c] << (8 - format->depth - bit % 8);
+                    }
+                }
+            }
+
+            out[0] = (y + pass) % 5;
+            filter_row(out[0], out + 1, row, prev, len, bpp);
+            put(&raw, out, len + 1);
+            memcpy(prev, row, len);
+        }
+
+        free(prev);
+        free(row);
+        free(out);
+    }
+
+    mz_ulong zlen = mz_compressBound(raw.size);
+    uint8_t *zdata = malloc(zlen);
+    mz_compress(zdata, &zlen, raw.data, raw.size);
+
+    uint8_t ihdr[13] = {0};
+    for (int i = 0; i < 4; i++)
+    {
+        ihdr[i] = format->width >> (24 - i * 8);
+        ihdr[4 + i] = format->height >> (24 - i * 8);
+    }
+    ihdr[8] = format->depth;
+    ihdr[9] = format->colorType;
+    ihdr[12] = format->interlace;
+
+    put(&png, "\x89PNG\r\n\x1a\n", 8);
+    put_chunk(&png, "IHDR", ihdr, sizeof(ihdr));
+    if (img->paletteItems)
+        put_chunk(&png, "PLTE", img->palette, img->paletteItems * 3);
+    // Several IDAT chunks, the inflate stream continues across them
+    for (size_t pos = 0; pos < zlen; pos += 1000)
+        put_chunk(&png, "IDAT", zdata + pos, zlen - pos < 1000 ? zlen - pos : 1000);
+    put_chunk(&png, "IEND", NULL, 0);
+
+    free(zdata);
+    free(raw.data);
+
+    return png;
+}
+
+// The 8 bit RGB a row decode should see for the pixel at x, y
+static void image_rgb(const image_t *img, int x, int y, uint32_t rgb[3])
+{
+    const format_t *format = img->format;
+    int channels = channels_of(format->colorType);
+    const uint16_t *s = img->samples + (y * format->width + x) * channels;
+    const uint8_t scale[] = {0, 0xFF, 0x55, 0, 0x11, 0, 0, 0, 1};
+
+    for (int c = 0; c < 3; c++)
+    {
+        if (img->paletteItems)
+            rgb[c] = img->palette[s[0] * 3 + c];
+        else if (channels < 3)
+            rgb[c] = format->depth == 16 ? s[0] >> 8 : s[0] * scale[format->depth];
+        else
+            rgb[c] = format->depth == 16 ? s[c] >> 8 : s[c];
+    }
+}
+
+/* Decoding */
+
+typedef struct {
+    uint16_t *data;
+    int width, height, rows;
+} output_t;
+
+static int store_row(const uint16_t *row, int32_t y, int32_t width, int32_t height, void *arg)
+{
+    output_t *out = (output_t*)arg;
+
+    if (!out->data)
+    {
+        out->width = width;
+        out->height = height;
+        out->data = track_alloc(width * height * 2, NULL);
+    }
+
+    memcpy(out->data + y * width, row, width * 2);
+    out->rows++;
+
+    return 0;
+}
+
+static int decode_rows(const buffer_t *png, int max, output_t *out, double *ms, size_t *peak)
+{
+    reader_t reader = {png->data, png->size, 0};
+    LuUserContext ctx;
+
+    context_init(&ctx, &reader);
+    memset(out, 0, sizeof(*out));
+    heap_used = heap_peak = 0;
+
+    int64_t start = esp_timer_get_time();
+    int ret = luPngReadRows(&ctx, max, max, &store_row, out);
+    *ms = (esp_timer_get_time() - start) / 1000.0;
+    *peak = heap_peak;
+
+    return ret == 0 && out->rows == out->height ? 0 : -1;
+}
+
+// Whole image, then converted to RGB565 and scaled the way the rows are:
+// averaged, or sampled when the PNG is interlaced (IHDR interlace byte)
+static LuImage *decode_full(const buffer_t *png, int max, output_t *out, double *ms, size_t *peak)
+{
+    reader_t reader = {png->data, png->size, 0};
+    LuUserContext ctx;
+
+    context_init(&ctx, &reader);
+    memset(out, 0, sizeof(*out));
+    heap_used = heap_peak = 0;
+
+    int64_t start = esp_timer_get_time();
+    LuImage *img = luPngReadUC(&ctx);
+
+    if (img)
+    {
+        int scale_x = max ? (img->width + max - 1) / max : 1, scale_y = max ? (img->height + max - 1) / max : 1;
+        int scale = scale_x > scale_y ? scale_x : scale_y;
+        int side = png->data[28] ? 1 : scale, area = side * side;
+
+        out->width = img->width / scale ?: 1;
+        out->height = img->height / scale ?: 1;
+        out->data = track_alloc(out->width * out->height * 2, NULL);
+
+        for (int y = 0; y < out->height; y++)
+        {
+            for (int x = 0; x < out->width; x++)
+            {
+                uint32_t sums[3] = {0};
+                for (int j = 0; j < area; j++)
+                {
+                    int idx = ((y * scale + j / side) * img->width + x * scale + j % side) * img->channels;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        int ch = img->channels < 3 ? 0 : c;
+                        sums[c] += img->depth == 16 ? ((uint16_t*)img->data)[idx + ch] >> 8 : img->data[idx + ch];
+                    }
+                }
+                out->data[y * out->width + x] = rgb565(sums[0] / area, sums[1] / area, sums[2] / area);
+            }
+        }
+    }
+
+    *ms = (esp_timer_get_time() - start) / 1000.0;
+    *peak = heap_peak;
+
+    return img;
+}
+
+static void release(LuImage *img, output_t *out)
+{
+    if (img)
+    {
+        track_free(img->data, NULL);
+        track_free(img, NULL);
+    }
+    track_free(out->data, NULL);
+}
+
+// The full decode must hold exactly the encoded samples (palette entries
+// for paletted images)
+static int check_full(const image_t *img, const LuImage *full)
+{
+    const format_t *format = img->format;
+    int channels = channels_of(format->colorType);
+    const uint8_t scale[] = {0, 0xFF, 0x55, 0, 0x11, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1};
+
+    for (int i = 0; i < format->width * format->height; i++)
+    {
+        for (int c = 0; c < full->channels; c++)
+        {
+            uint32_t expected = img->paletteItems ? img->palette[img->samples[i] * 3 + c]
+                                                  : img->samples[i * channels + c] * scale[format->depth];
+            uint32_t value = full->depth == 16 ? ((uint16_t*)full->data)[i * full->channels + c]
+                                               : full->data[i * full->channels + c];
+            if (value != expected)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Rows scaled by an integer factor: box average, or sampled when interlaced
+static int check_rows(const image_t *img, const output_t *rows, int max)
+{
+    const format_t *format = img->format;
+    int scale_x = max ? (format->width + max - 1) / max : 1, scale_y = max ? (format->height + max - 1) / max : 1;
+    int scale = scale_x > scale_y ? scale_x : scale_y;
+    int width = format->width / scale ?: 1, height = format->height / scale ?: 1;
+
+    if (rows->width != width || rows->height != height)
+        return -1;
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            uint32_t sums[3] = {0}, rgb[3];
+            int area = format->interlace ? 1 : scale * scale;
+
+            for (int j = 0; j < area; j++)
+            {
+                image_rgb(img, x * scale + j % scale, y * scale + j / scale, rgb);
+                for (int c = 0; c < 3; c++)
+                    sums[c] += rgb[c];
+            }
+
+            if (rows->data[y * width + x] != rgb565(sums[0] / area, sums[1] / area, sums[2] / area))
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int test_generated(void)
+{
+    int failed = 0;
+
+    for (int n = 0; n < sizeof(formats) / sizeof(formats[0]); n++)
+    {
+        const format_t *format = &formats[n];
+        image_t img = {0};
+        output_t full_out, rows_out, scaled_out;
+        double full_ms, rows_ms, scaled_ms;
+        size_t full_peak, rows_peak, scaled_peak;
+        const char *error = NULL;
+
+        image_generate(&img, format, n + 1);
+        buffer_t png = image_encode(&img);
+
+        LuImage *full = decode_full(&png, COVER_MAX_SIZE, &full_out, &full_ms, &full_peak);
+        int rows = decode_rows(&png, 0, &rows_out, &rows_ms, &rows_peak);
+        int scaled = decode_rows(&png, COVER_MAX_SIZE, &scaled_out, &scaled_ms, &scaled_peak);
+
+        if (!full || check_full(&img, full) != 0)
+            error = "full decode differs from the encoded pixels";
+        else if (rows != 0 || check_rows(&img, &rows_out, 0) != 0)
+            error = "rows differ from the encoded pixels";
+        else if (scaled != 0 || check_rows(&img, &scaled_out, COVER_MAX_SIZE) != 0)
+            error = "scaled rows differ from the encoded pixels";
+        else if (full_out.width != scaled_out.width || full_out.height != scaled_out.height
+            || memcmp(full_out.data, scaled_out.data, full_out.width * full_out.height * 2) != 0)
+            error = "scaled rows differ from the scaled full decode";
+
+        printf("%-16s %3dx%-3d %s  full %.2fms %zuKB, rows %.2fms %zuKB\n", format->name,
+            format->width, format->height, error ? "FAIL" : "OK  ", full_ms, full_peak / 1024,
+            scaled_ms, scaled_peak / 1024);
+        if (error)
+        {
+            printf("  %s\n", error);
+            failed++;
+        }
+
+        release(full, &full_out);
+        release(NULL, &rows_out);
+        release(NULL, &scaled_out);
+        free(img.samples);
+        free(png.data);
+    }
+
+    return failed;
+}
+
+static int benchmark_dir(const char *path)
+{
+    double full_total = 0, rows_total = 0;
+    size_t full_max = 0, rows_max = 0;
+    int count = 0, failed = 0;
+    struct dirent *ent;
+
+    DIR *dir = opendir(path);
+    if (!dir)
+    {
+        printf("Can't open %s\n", path);
+        return 1;
+    }
+
+    while ((ent = readdir(dir)))
+    {
+        const char *ext = strrchr(ent->d_name, '.');
+        char file[1024];
+        struct stat st;
+
+        if (!ext || strcasecmp(ext, ".png") != 0)
+            continue;
+
+        snprintf(file, sizeof(file), "%s/%s", path, ent->d_name);
+        FILE *fp = fopen(file, "rb");
+        if (!fp || fstat(fileno(fp), &st) != 0)
+            continue;
+
+        buffer_t png = {malloc(st.st_size), st.st_size};
+        png.size = fread(png.data, 1, st.st_size, fp);
+        fclose(fp);
+
+        output_t full_out, rows_out;
+        double full_ms, rows_ms;
+        size_t full_peak, rows_peak;
+
+        LuImage *full = decode_full(&png, COVER_MAX_SIZE, &full_out, &full_ms, &full_peak);
+        int rows = decode_rows(&png, COVER_MAX_SIZE, &rows_out, &rows_ms, &rows_peak);
+        bool same = full && rows == 0 && full_out.width == rows_out.width && full_out.height == rows_out.height
+            && memcmp(full_out.data, rows_out.data, full_out.width * full_out.height * 2) == 0;
+
+        printf("%-32s %s  full %.2fms %zuKB, rows %.2fms %zuKB\n", ent->d_name, same ? "OK  " : "FAIL",
+            full_ms, full_peak / 1024, rows_ms, rows_peak / 1024);
+
+        full_total += full_ms;
+        rows_total += rows_ms;
+        full_max = full_peak > full_max ? full_peak : full_max;
+        rows_max = rows_peak > rows_max ? rows_peak : rows_max;
+        failed += !same;
+        count++;
+
+        release(full, &full_out);
+        release(NULL, &rows_out);
+        free(png.data);
+    }
+
+    closedir(dir);
+
+    if (count)
+        printf("%d files: mean time full %.2fms, rows %.2fms. Worst peak full %zuKB, rows %zuKB\n", count,
+            full_total / count, rows_total / count, full_max / 1024, rows_max / 1024);
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = argc > 1 ? benchmark_dir(argv[1]) : test_generated();
+
+    return failed ? 1 : 0;
+}
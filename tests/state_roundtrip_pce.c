@@ -0,0 +1,263 @@
+/* Save state round trip for the huexpress core: run a rom, save a state to
+   memory, run on while recording frame hashes, restore the state and check
+   that the same frames come out again. The memory state must also match the
+   state file byte for byte, and the decoded tiles and sprites must always
+   match a full decode of VRAM. Every rom runs with idle loop skipping off
+   and on, both must give the same states and frames. The roms are tiny
+   programs built below. */
+
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "pce.h"
+#include "rom/crc.h"
+
+#define FRAMES_BEFORE 60
+#define CHUNKS        5
+#define CHUNK_FRAMES  20
+
+extern uchar *SPM_raw, *SPM;
+
+uchar *osd_gfx_buffer;
+uint osd_skipFrames;
+
+static uchar framebuffer[XBUF_WIDTH * XBUF_HEIGHT];
+static jmp_buf frame_jmp;
+static int frames, frames_max;
+
+// What a run produced, compared between idle skip off and on
+typedef struct {
+    uint32 state_crc;
+    uint32 hashes[CHUNKS];
+} trace_t;
+
+void osd_log(const char *fmt, ...) {}
+void osd_gfx_init(void)
+{
+    SPM_raw = calloc(XBUF_WIDTH * XBUF_HEIGHT, 1);
+    SPM = SPM_raw + XBUF_WIDTH * 64 + 32;
+    osd_gfx_buffer = framebuffer + 32 + 64 * XBUF_WIDTH;
+}
+void osd_gfx_set_mode(short width, short height) {}
+void osd_gfx_blit(void) { if (++frames >= frames_max) longjmp(frame_jmp, 1); }
+void osd_gfx_shutdown(void) {}
+void osd_gfx_set_color(uchar index, uchar r, uchar g, uchar b) {}
+int osd_keyboard(void) { return 0; }
+int osd_init_input(void) { return 0; }
+void osd_wait_next_vsync(void) {}
+void osd_snd_init() {}
+void osd_snd_shutdown() {}
+
+static const struct {
+    const char *name;
+    uchar code[48];
+    uchar irq[8];
+} roms[] = {
+    // IRQ driven wait on a zero page counter, then a busy loop
+    {"irq wait", {0x78, 0x03, 0x05, 0x13, 0x08, 0x23, 0x00, 0x58, 0xA5, 0x10, 0xC5, 0x10, 0xF0, 0xFC,
+                  0xE6, 0x11, 0xA2, 0x00, 0xE8, 0xD0, 0xFD, 0x80, 0xF0},
+                 {0x48, 0xAD, 0x00, 0x00, 0xE6, 0x10, 0x68, 0x40}},
+    // Poll the VDC status with interrupts off
+    {"vdc poll", {0x78, 0x03, 0x05, 0x13, 0x08, 0x23, 0x00, 0xAD, 0x00, 0x00, 0x29, 0x20, 0xF0, 0xF9,
+                  0xE6, 0x11, 0x80, 0xF5}},
+    // BBR0 self loop, bit 0 set by the IRQ handler
+    {"bbr loop", {0x78, 0x03, 0x05, 0x13, 0x08, 0x23, 0x00, 0x58, 0x0F, 0x10, 0xFD, 0xE6, 0x11, 0xA9,
+                  0x00, 0x85, 0x10, 0x80, 0xF5},
+                 {0x48, 0xAD, 0x00, 0x00, 0xE6, 0x10, 0x68, 0x40}},
+    // Background on, the first 256 VRAM words (the BAT) rewritten with X/Y counters
+    {"vram fill", {0x78, 0x03, 0x05, 0x13, 0x88, 0x23, 0x00, 0x03, 0x00, 0x13, 0x00, 0x23, 0x00, 0x03,
+                   0x02, 0xE8, 0x8E, 0x02, 0x00, 0x8C, 0x03, 0x00, 0xD0, 0xF7, 0xC8, 0x80, 0xEC}},
+    // One word written at $1000, then $1000-$100F copied to $2000 by VRAM DMA
+    {"vram dma", {0x78, 0x03, 0x05, 0x13, 0x88, 0x23, 0x00, 0x03, 0x00, 0x13, 0x00, 0x23, 0x10, 0x03,
+                  0x02, 0xE8, 0x8E, 0x02, 0x00, 0x8C, 0x03, 0x00, 0x03, 0x10, 0x13, 0x00, 0x23, 0x10,
+                  0x03, 0x11, 0x13, 0x00, 0x23, 0x20, 0x03, 0x12, 0x13, 0x0F, 0x23, 0x00, 0xC8, 0x80,
+                  0xDC}},
+};
+
+static void make_rom(const char *path, int n)
+{
+    uchar rom[0x2000] = {0};
+
+    memcpy(rom, roms[n].code, sizeof(roms[n].code));
+    memcpy(rom + 0x100, roms[n].irq, sizeof(roms[n].irq));
+
+    // Reset at $E000, everything else at the IRQ handler ($E100)
+    const uint16 vectors[] = {0xFFF6, 0xFFF8, 0xFFFA, 0xFFFC};
+    for (int i = 0; i < 4; i++)
+    {
+        rom[vectors[i] - 0xE000] = 0x00;
+        rom[vectors[i] - 0xE000 + 1] = 0xE1;
+    }
+    rom[0x1FFE] = 0x00;
+    rom[0x1FFF] = 0xE0;
+
+    FILE *fp = fopen(path, "wb");
+    fwrite(rom, sizeof(rom), 1, fp);
+    fclose(fp);
+}
+
+static uint32 frame_hash(void)
+{
+    uint32 hash = 0;
+    for (int i = 0; i < 0x2000; i++)
+        hash = hash * 31 + RAM[i];
+    for (int i = 0; i < 0x10000; i++)
+        hash = hash * 31 + VRAM[i];
+    for (int i = 0; i < XBUF_WIDTH * XBUF_HEIGHT; i++)
+        hash = hash * 31 + framebuffer[i];
+    return hash;
+}
+
+// The cache is only decoded where flagged, it must match decoding all of it
+static bool cache_consistent(void)
+{
+    static uchar planes[VRAMSIZE], sprites[VRAMSIZE];
+    bool lines = SPR_CACHE.Lines;
+
+    sprite_cache_update();
+    memcpy(planes, VRAM2, VRAMSIZE);
+    memcpy(sprites, VRAMS, VRAMSIZE);
+
+    sprite_cache_invalidate();
+    sprite_cache_update();
+    SPR_CACHE.Lines = lines;
+
+    return memcmp(planes, VRAM2, VRAMSIZE) == 0 && memcmp(sprites, VRAMS, VRAMSIZE) == 0;
+}
+
+static void run_frames(int count)
+{
+    frames = 0;
+    frames_max = count;
+    if (!setjmp(frame_jmp))
+        RunPCE();
+}
+
+static int test_rom(int n, bool idle_skip, trace_t *trace)
+{
+    char rom_path[] = "/tmp/roundtrip_XXXXXX.pce";
+    char state_path[] = "/tmp/roundtrip_XXXXXX.sav";
+    uint32 *hashes = trace->hashes;
+    int ret = 0;
+
+    close(mkstemps(rom_path, 4));
+    close(mkstemps(state_path, 4));
+    make_rom(rom_path, n);
+
+    if (InitPCE(rom_path) != 0)
+    {
+        printf("%s: InitPCE failed\n", roms[n].name);
+        return 1;
+    }
+
+    host.options.idleSkip = idle_skip;
+
+    run_frames(FRAMES_BEFORE);
+
+    size_t size = SaveStateSize();
+    uchar *state = malloc(size);
+    uchar *file_state = malloc(size);
+    int len = SaveStateMem(state, size);
+    trace->state_crc = crc32_le(0, state, size);
+
+    SaveState(state_path);
+    FILE *fp = fopen(state_path, "rb");
+    size_t file_len = fread(file_state, 1, size, fp);
+    fclose(fp);
+
+    if (len <= 0 || file_len != len || memcmp(state, file_state, len) != 0)
+    {
+        printf("%s: memory state (%d bytes) differs from the state file (%d bytes)\n",
+            roms[n].name, len, (int)file_len);
+        ret = 1;
+    }
+
+    for (int i = 0; i < CHUNKS; i++)
+    {
+        run_frames(CHUNK_FRAMES);
+        hashes[i] = frame_hash();
+        if (!cache_consistent())
+        {
+            printf("%s: decoded patterns differ from VRAM at frame %d\n", roms[n].name,
+                FRAMES_BEFORE + (i + 1) * CHUNK_FRAMES);
+            ret = 1;
+        }
+    }
+
+    if (LoadStateMem(state, len) != 0)
+    {
+        printf("%s: LoadStateMem failed\n", roms[n].name);
+        ret = 1;
+    }
+    else if (!cache_consistent())
+    {
+        printf("%s: decoded patterns differ from VRAM after restoring\n", roms[n].name);
+        ret = 1;
+    }
+
+    for (int i = 0; i < CHUNKS && ret == 0; i++)
+    {
+        run_frames(CHUNK_FRAMES);
+        uint32 hash = frame_hash();
+        if (hash != hashes[i])
+        {
+            printf("%s: frame %d differs after restoring (%08x != %08x)\n", roms[n].name,
+                FRAMES_BEFORE + (i + 1) * CHUNK_FRAMES, hash, hashes[i]);
+            ret = 1;
+        }
+    }
+
+    printf("%s, idle skip %s: %s (%d bytes)\n", roms[n].name, idle_skip ? "on" : "off",
+        ret ? "FAIL" : "OK", len);
+
+    unlink(rom_path);
+    unlink(state_path);
+    free(state);
+    free(file_state);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+
+    // The core isn't meant to be initialized twice, each run gets a process
+    for (int n = 0; n < sizeof(roms) / sizeof(roms[0]); n++)
+    {
+        trace_t traces[2] = {0};
+
+        for (int idle_skip = 0; idle_skip < 2; idle_skip++)
+        {
+            int results[2];
+            pipe(results);
+            fflush(stdout);
+
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                int ret = test_rom(n, idle_skip, &traces[idle_skip]);
+                write(results[1], &traces[idle_skip], sizeof(trace_t));
+                exit(ret);
+            }
+            close(results[1]);
+
+            if (read(results[0], &traces[idle_skip], sizeof(trace_t)) != sizeof(trace_t))
+                failed++;
+            close(results[0]);
+
+            int status;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                failed++;
+        }
+
+        if (memcmp(&traces[0], &traces[1], sizeof(trace_t)) != 0)
+        {
+            printf("%s: idle skip changes the states or frames\n", roms[n].name);
+            failed++;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+/* Save state round trip for the smsplus core: run a rom, save a state to
+   memory, run on while recording frame hashes, restore the state and check
+   that the same frames come out again. The memory state must also match the
+   state file byte for byte, and a state from another console is refused. */
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "shared.h"
+
+#define FRAMES_BEFORE 60
+#define FRAMES_AFTER  125 // The page in slot 2 differs when restoring
+
+#define SMS_WIDTH     256
+#define SMS_HEIGHT    192
+
+static uint8 framebuffer[SMS_WIDTH * SMS_HEIGHT];
+
+void system_manage_sram(uint8 *sram, int slot, int mode) {}
+
+static const struct {
+    const char *name;
+    uint8 code[64];
+} roms[] = {
+    // Mode 4, display and vblank IRQ on, VRAM and PSG written from a RAM counter
+    {"vram fill", {0xF3, 0x31, 0xF0, 0xDF, 0xED, 0x56, 0x3E, 0x36, 0xD3, 0xBF, 0x3E, 0x80, 0xD3, 0xBF,
+                   0x3E, 0xE0, 0xD3, 0xBF, 0x3E, 0x81, 0xD3, 0xBF, 0xAF, 0xD3, 0xBF, 0x3E, 0x40, 0xD3,
+                   0xBF, 0xFB, 0x3A, 0x00, 0xC0, 0xD3, 0xBE, 0xD3, 0x7F, 0x18, 0xF7}},
+    // VRAM written from slot 2, the page there follows the RAM counter (B holds the last one)
+    {"mapper", {0xF3, 0x31, 0xF0, 0xDF, 0xED, 0x56, 0x3E, 0x36, 0xD3, 0xBF, 0x3E, 0x80, 0xD3, 0xBF,
+                0x3E, 0xE0, 0xD3, 0xBF, 0x3E, 0x81, 0xD3, 0xBF, 0xAF, 0xD3, 0xBF, 0x3E, 0x40, 0xD3,
+                0xBF, 0xFB, 0x3A, 0x00, 0x80, 0xD3, 0xBE, 0x3A, 0x00, 0xC0, 0xE6, 0x03, 0xB8, 0x28,
+                0xF3, 0x47, 0x32, 0xFF, 0xFF, 0x18, 0xED}},
+};
+
+// Vblank handler at $38: ack the VDP and bump the counter at $C000
+static const uint8 irq[] = {0xF5, 0xDB, 0xBF, 0x3A, 0x00, 0xC0, 0x3C, 0x32, 0x00, 0xC0, 0xF1,
+                            0xFB, 0xED, 0x4D};
+
+static void make_rom(const char *path, int n)
+{
+    static uint8 rom[0x10000];
+
+    // Every page is filled with its own pattern so bank switches show up
+    for (int i = 0; i < sizeof(rom); i++)
+        rom[i] = (i >> 14) * 0x11 + (i & 0x0F);
+
+    memcpy(rom, roms[n].code, sizeof(roms[n].code));
+    memcpy(rom + 0x38, irq, sizeof(irq));
+    rom[0x66] = 0xED; // retn
+    rom[0x67] = 0x45;
+
+    FILE *fp = fopen(path, "wb");
+    fwrite(rom, sizeof(rom), 1, fp);
+    fclose(fp);
+}
+
+static uint32_t frame_hash(void)
+{
+    uint32_t hash = 0;
+    for (int i = 0; i < sizeof(sms.wram); i++)
+        hash = hash * 31 + sms.wram[i];
+    for (int i = 0; i < sizeof(vdp.vram); i++)
+        hash = hash * 31 + vdp.vram[i];
+    for (int i = 0; i < sizeof(framebuffer); i++)
+        hash = hash * 31 + framebuffer[i];
+    for (int i = 0; i < snd.sample_count; i++)
+        hash = hash * 31 + snd.output[0][i];
+    return hash;
+}
+
+static int test_rom(int n)
+{
+    char rom_path[] = "/tmp/roundtrip_XXXXXX.sms";
+    char state_path[] = "/tmp/roundtrip_XXXXXX.sav";
+    uint32_t hashes[FRAMES_AFTER];
+    int ret = 0;
+
+    close(mkstemps(rom_path, 4));
+    close(mkstemps(state_path, 4));
+    make_rom(rom_path, n);
+
+    load_rom(rom_path);
+    system_reset_config();
+
+    bitmap.width = SMS_WIDTH;
+    bitmap.height = SMS_HEIGHT;
+    bitmap.pitch = bitmap.width;
+    bitmap.data = framebuffer;
+
+    option.sndrate = 32000;
+    option.overscan = 0;
+    option.extra_gg = 0;
+
+    system_init2();
+    system_reset();
+
+    for (int i = 0; i < FRAMES_BEFORE; i++)
+        system_frame(0);
+
+    int size = system_state_size();
+    uint8 *state = malloc(size);
+    uint8 *file_state = malloc(size);
+    int len = system_save_state_mem(state, size);
+
+    FILE *fp = fopen(state_path, "wb");
+    system_save_state(fp);
+    fclose(fp);
+    fp = fopen(state_path, "rb");
+    int file_len = fread(file_state, 1, size, fp);
+    fclose(fp);
+
+    if (len <= 0 || file_len != len || memcmp(state, file_state, len) != 0)
+    {
+        printf("%s: memory state (%d bytes) differs from the state file (%d bytes)\n",
+            roms[n].name, len, file_len);
+        ret = 1;
+    }
+
+    for (int i = 0; i < FRAMES_AFTER; i++)
+    {
+        system_frame(0);
+        hashes[i] = frame_hash();
+    }
+
+    // A state from another console must be refused and leave the machine alone
+    uint32_t hash_before = frame_hash();
+    file_state[offsetof(sms_t, console)] = CONSOLE_GG;
+    if (system_load_state_mem(file_state, len) != -1 || frame_hash() != hash_before)
+    {
+        printf("%s: state from another console was not refused\n", roms[n].name);
+        ret = 1;
+    }
+
+    if (system_load_state_mem(state, len) != 0)
+    {
+        printf("%s: system_load_state_mem failed\n", roms[n].name);
+        ret = 1;
+    }
+
+    for (int i = 0; i < FRAMES_AFTER && ret == 0; i++)
+    {
+        system_frame(0);
+        uint32_t hash = frame_hash();
+        if (hash != hashes[i])
+        {
+            printf("%s: frame %d differs after restoring (%08" PRIx32 " != %08" PRIx32 ")\n", roms[n].name,
+                FRAMES_BEFORE + i + 1, hash, hashes[i]);
+            ret = 1;
+        }
+    }
+
+    printf("%s: %s (%d bytes)\n", roms[n].name, ret ? "FAIL" : "OK", len);
+
+    unlink(rom_path);
+    unlink(state_path);
+    free(state);
+    free(file_state);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+
+    // The core isn't meant to be initialized twice, each rom gets a process
+    for (int n = 0; n < sizeof(roms) / sizeof(roms[0]); n++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+            exit(test_rom(n));
+
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed++;
+    }
+
+    return failed ? 1 : 0;
+}